@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <applicationdescription.h>
+#include <jsonreader.h>
+
+#include "benchmarkrunner.h"
+
+using namespace luna;
+
+static QString smallManifest()
+{
+    return QString("{"
+        "\"id\": \"com.example.app\","
+        "\"version\": \"1.0.0\","
+        "\"vendor\": \"Example\","
+        "\"type\": \"web\","
+        "\"main\": \"index.html\","
+        "\"title\": \"Example\","
+        "\"icon\": \"icon.png\","
+        "\"uiRevision\": 2"
+        "}");
+}
+
+/*
+ * Something like a big Enyo app: many allowed urls, all the optional fields
+ * and a bunch of keys we don't read at all.
+ */
+static QString largeManifest()
+{
+    QJsonObject manifest;
+    manifest.insert("id", QString("org.webosports.app.browser"));
+    manifest.insert("version", QString("0.9.42"));
+    manifest.insert("vendor", QString("webOS ports"));
+    manifest.insert("type", QString("web"));
+    manifest.insert("main", QString("index.html"));
+    manifest.insert("title", QString("A rather long application title for a browser"));
+    manifest.insert("icon", QString("images/icons/browser-icon-256x256.png"));
+    manifest.insert("uiRevision", 2);
+    manifest.insert("noWindow", false);
+    manifest.insert("flickable", true);
+    manifest.insert("internetConnectivityRequired", true);
+    manifest.insert("loadingAnimationDisabled", true);
+    manifest.insert("streamServiceResponses", true);
+    manifest.insert("plugin", QString("browserplugin"));
+    manifest.insert("userAgent", QString("Mozilla/5.0 (Linux; webOS/3.0.5; U; en-US) "
+                                         "AppleWebKit/537.36 (KHTML, like Gecko) Mobile Safari/537.36"));
+
+    QJsonArray urlsAllowed;
+    for (int n = 0; n < 100; n++)
+        urlsAllowed.append(QString("^https://([a-z]+\\.)?service%1\\.example\\.com/api/v2/").arg(n));
+    manifest.insert("urlsAllowed", urlsAllowed);
+
+    QJsonArray keywords;
+    for (int n = 0; n < 50; n++)
+        keywords.append(QString("keyword%1").arg(n));
+    manifest.insert("keywords", keywords);
+
+    QJsonObject localization;
+    for (int n = 0; n < 30; n++)
+        localization.insert(QString("locale%1").arg(n), QString("A localized title number %1").arg(n));
+    manifest.insert("localization", localization);
+
+    return QString::fromUtf8(QJsonDocument(manifest).toJson(QJsonDocument::Compact));
+}
+
+class ApplicationDescriptionBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void parse_data()
+    {
+        QTest::addColumn<QString>("manifest");
+
+        QTest::newRow("small") << smallManifest();
+        QTest::newRow("large") << largeManifest();
+    }
+
+    void parse()
+    {
+        QFETCH(QString, manifest);
+
+        QBENCHMARK {
+            ApplicationDescription description(manifest, "/usr/palm/applications/com.example.app");
+            Q_UNUSED(description);
+        }
+    }
+
+    void readFields_data()
+    {
+        parse_data();
+    }
+
+    // the way the description reads its fields, once with the reader it uses
+    // and once with a full QJsonDocument for comparison
+    void readFields()
+    {
+        QFETCH(QString, manifest);
+
+        QBENCHMARK {
+            JsonReader reader(manifest.toUtf8());
+            QString id = reader.stringValue("id");
+            QString main = reader.stringValue("main");
+            bool flickable = reader.boolValue("flickable");
+            QStringList urlsAllowed = reader.stringListValue("urlsAllowed");
+            Q_UNUSED(id);
+            Q_UNUSED(main);
+            Q_UNUSED(flickable);
+            Q_UNUSED(urlsAllowed);
+        }
+    }
+
+    void readFieldsQJsonDocument_data()
+    {
+        parse_data();
+    }
+
+    void readFieldsQJsonDocument()
+    {
+        QFETCH(QString, manifest);
+
+        QBENCHMARK {
+            QJsonObject object = QJsonDocument::fromJson(manifest.toUtf8()).object();
+            QString id = object.value("id").toString();
+            QString main = object.value("main").toString();
+            bool flickable = object.value("flickable").toBool();
+            QStringList urlsAllowed;
+            Q_FOREACH(const QJsonValue &value, object.value("urlsAllowed").toArray())
+                urlsAllowed << value.toString();
+            Q_UNUSED(id);
+            Q_UNUSED(main);
+            Q_UNUSED(flickable);
+        }
+    }
+};
+
+BENCHMARK_MAIN(ApplicationDescriptionBenchmark, "applicationdescription")
+
+#include "applicationdescriptionbenchmark.moc"
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QTemporaryFile>
+#include <QXmlStreamReader>
+
+#include <stdio.h>
+
+#include "benchmarkrunner.h"
+
+namespace luna
+{
+
+static QJsonArray reportedMetrics;
+
+void reportMetric(const QString &metric, double value, const QString &unit)
+{
+    QJsonObject result;
+    result.insert("function", QString::fromUtf8(QTest::currentTestFunction()));
+    result.insert("tag", QString::fromUtf8(QTest::currentDataTag()));
+    result.insert("metric", metric);
+    result.insert("unit", unit);
+    result.insert("value", value);
+    result.insert("iterations", 1);
+    result.insert("valuePerIteration", value);
+    reportedMetrics.append(result);
+}
+
+/*
+ * QtTest has no JSON output so we let it write its XML log and convert the
+ * benchmark results and failures of that.
+ */
+static QJsonObject convertLog(QIODevice *log, const QString &suite, int &failures)
+{
+    QJsonArray results = reportedMetrics;
+    QJsonArray failed;
+    QString function;
+
+    QXmlStreamReader xml(log);
+    while (!xml.atEnd()) {
+        if (xml.readNext() != QXmlStreamReader::StartElement)
+            continue;
+
+        QXmlStreamAttributes attributes = xml.attributes();
+
+        if (xml.name() == "TestFunction") {
+            function = attributes.value("name").toString();
+        }
+        else if (xml.name() == "BenchmarkResult") {
+            double value = attributes.value("value").toString().toDouble();
+            int iterations = attributes.value("iterations").toString().toInt();
+
+            QJsonObject result;
+            result.insert("function", function);
+            result.insert("tag", attributes.value("tag").toString());
+            result.insert("metric", attributes.value("metric").toString());
+            result.insert("value", value);
+            result.insert("iterations", iterations);
+            result.insert("valuePerIteration", iterations > 0 ? value / iterations : value);
+            results.append(result);
+        }
+        else if (xml.name() == "Incident") {
+            QString type = attributes.value("type").toString();
+            if (type != "fail" && type != "xpass")
+                continue;
+
+            QJsonObject failure;
+            failure.insert("function", function);
+            failure.insert("file", attributes.value("file").toString());
+            failure.insert("line", attributes.value("line").toString().toInt());
+            failed.append(failure);
+        }
+    }
+
+    if (xml.hasError())
+        qWarning("Failed to read the test log: %s", qPrintable(xml.errorString()));
+
+    failures = failed.count();
+
+    QJsonObject document;
+    document.insert("suite", suite);
+    document.insert("qtVersion", QString(qVersion()));
+    document.insert("timestamp", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    document.insert("results", results);
+    document.insert("failures", failed);
+    return document;
+}
+
+static void printSummary(const QJsonObject &document)
+{
+    Q_FOREACH(const QJsonValue &value, document.value("results").toArray()) {
+        QJsonObject result = value.toObject();
+        QString name = result.value("function").toString();
+        if (!result.value("tag").toString().isEmpty())
+            name += QString(":%1").arg(result.value("tag").toString());
+
+        QString metric = result.value("metric").toString();
+        if (result.contains("unit"))
+            metric += QString(" (%1)").arg(result.value("unit").toString());
+
+        printf("%-60s %14.4f %s\n", qPrintable(name),
+               result.value("valuePerIteration").toDouble(), qPrintable(metric));
+    }
+}
+
+int runBenchmarks(QObject *benchmark, const QString &suite, int argc, char **argv)
+{
+    QString output = QString("%1.json").arg(suite);
+    QStringList arguments;
+
+    for (int n = 0; n < argc; n++) {
+        if (qstrcmp(argv[n], "--json") == 0 && n + 1 < argc)
+            output = QString::fromLocal8Bit(argv[++n]);
+        else
+            arguments << QString::fromLocal8Bit(argv[n]);
+    }
+
+    QTemporaryFile log;
+    if (!log.open()) {
+        qWarning("Failed to create a temporary file for the test log");
+        return 1;
+    }
+
+    arguments << "-xml" << "-o" << log.fileName();
+
+    // The launcher code is rather chatty which would only disturb the timing
+    QLoggingCategory::setFilterRules("default.debug=false");
+
+    int status = QTest::qExec(benchmark, arguments);
+
+    log.seek(0);
+    int failures = 0;
+    QJsonObject document = convertLog(&log, suite, failures);
+
+    QFile file(output);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("Failed to write benchmark results to %s", qPrintable(output));
+        return 1;
+    }
+
+    file.write(QJsonDocument(document).toJson());
+    file.close();
+
+    printSummary(document);
+    printf("%d failures, results written to %s\n", failures, qPrintable(output));
+
+    return status;
+}
+
+} // namespace luna
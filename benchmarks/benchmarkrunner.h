@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef BENCHMARKRUNNER_H
+#define BENCHMARKRUNNER_H
+
+#include <QCoreApplication>
+#include <QtTest>
+
+namespace luna
+{
+
+/**
+ * Runs the QBENCHMARK cases of a test object and writes the results as JSON
+ * so they can be compared between releases. The file is given with
+ * --json <file> and defaults to <suite>.json in the current directory. All
+ * other arguments are passed on to QtTest, e.g. the functions to run.
+ */
+int runBenchmarks(QObject *benchmark, const QString &suite, int argc, char **argv);
+
+/**
+ * Adds a result which isn't measured with QBENCHMARK, like a throughput, to
+ * the current test function and data row.
+ */
+void reportMetric(const QString &metric, double value, const QString &unit);
+
+} // namespace luna
+
+#define BENCHMARK_MAIN(BenchmarkClass, suite) \
+int main(int argc, char **argv) \
+{ \
+    QCoreApplication app(argc, argv); \
+    BenchmarkClass benchmark; \
+    return luna::runBenchmarks(&benchmark, suite, argc, argv); \
+}
+
+#endif // BENCHMARKRUNNER_H
@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QElapsedTimer>
+#include <QTimer>
+
+#include <glib.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include <activity.h>
+#include <memoryaccounting.h>
+#include <systemtime.h>
+#include <extensions/lunaservicemgr.h>
+#include <extensions/palmservicebridgeextension.h>
+
+#include "benchmarkrunner.h"
+#include "fakelunabus.h"
+
+// Everything in here runs against the fake bus linked into the binary
+#define BENCHMARK_APP_ID        "org.webosports.benchmark"
+#define ECHO_URI                "luna://org.webosports.benchmark/echo"
+#define SUBSCRIPTION_URI        "luna://org.webosports.benchmark/subscribe"
+#define WAIT_TIMEOUT_MS         60000
+#define WARMUP_MS               1000
+#define SUSTAINED_LOAD_MS       5000
+
+using namespace luna;
+
+/*
+ * Collects how long replies took from being sent by the fake bus until they
+ * arrived where the launcher hands them to the page.
+ */
+class LatencyRecorder
+{
+public:
+    void record(const char *payload)
+    {
+        qint64 now = g_get_monotonic_time();
+        qint64 sent = FakeLunaBus::sentAt(payload);
+
+        if (sent >= 0)
+            mLatencies.push_back(now - sent);
+    }
+
+    int count() const
+    {
+        return mLatencies.size();
+    }
+
+    void clear()
+    {
+        mLatencies.clear();
+    }
+
+    void report()
+    {
+        if (mLatencies.empty())
+            return;
+
+        std::sort(mLatencies.begin(), mLatencies.end());
+
+        qint64 total = 0;
+        for (size_t n = 0; n < mLatencies.size(); n++)
+            total += mLatencies[n];
+
+        reportMetric("replyLatencyMean", (double) total / mLatencies.size(), "us");
+        reportMetric("replyLatencyP95", mLatencies[mLatencies.size() * 95 / 100], "us");
+        reportMetric("replyLatencyMax", mLatencies.back(), "us");
+    }
+
+private:
+    std::vector<qint64> mLatencies;
+};
+
+class CountingListener : public LunaServiceManagerListener
+{
+public:
+    explicit CountingListener(LatencyRecorder *recorder) :
+        mRecorder(recorder)
+    {
+    }
+
+    void serviceResponse(const char *body)
+    {
+        mRecorder->record(body);
+    }
+
+private:
+    LatencyRecorder *mRecorder;
+};
+
+/*
+ * Spins the event loop until the condition holds, the replies reach the
+ * GUI thread as posted events.
+ */
+static bool waitFor(const std::function<bool()> &condition, int timeout = WAIT_TIMEOUT_MS)
+{
+    // wake up now and then even if nothing is posted
+    QTimer tick;
+    tick.start(5);
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    while (!condition()) {
+        if (elapsed.elapsed() > timeout)
+            return false;
+
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+
+    return true;
+}
+
+static qint64 residentMemory()
+{
+    return MemoryAccounting::processMemory(QCoreApplication::applicationPid()).rss;
+}
+
+static double perSecond(qint64 count, qint64 nsecs)
+{
+    return nsecs > 0 ? count * 1000000000.0 / nsecs : 0;
+}
+
+/*
+ * Hands the replies of a set of bridges to the page the way
+ * PalmServiceBridgeExtension does and records when they got there.
+ */
+class BridgeSink : public QObject
+{
+    Q_OBJECT
+
+public:
+    BridgeSink() : mScriptCharacters(0) { }
+
+    ~BridgeSink()
+    {
+        qDeleteAll(mBridges);
+    }
+
+    PalmServiceBridge* createBridge()
+    {
+        PalmServiceBridge *bridge = new PalmServiceBridge(mBridges.count(), BENCHMARK_APP_ID, true);
+        connect(bridge, SIGNAL(callback(QString)), this, SLOT(callbackFromBridge(QString)));
+        mBridges.append(bridge);
+        return bridge;
+    }
+
+    QList<PalmServiceBridge*> bridges() const { return mBridges; }
+    LatencyRecorder& recorder() { return mRecorder; }
+    qint64 scriptCharacters() const { return mScriptCharacters; }
+
+    void reset()
+    {
+        mRecorder.clear();
+        mScriptCharacters = 0;
+    }
+
+private Q_SLOTS:
+    void callbackFromBridge(const QString &arguments)
+    {
+        PalmServiceBridge *bridge = static_cast<PalmServiceBridge*>(sender());
+
+        QString command = QString("__PalmServiceBridge_handleServiceResponse(%1, %2);")
+                .arg(bridge->instanceId()).arg(arguments);
+        mScriptCharacters += command.size();
+
+        // the arguments are the payload as a quoted script string; only the
+        // quotes of its leading sentAt field need to be unescaped. A cancel
+        // delivers an empty string.
+        if (arguments.size() > 2)
+            mRecorder.record(arguments.mid(1, 48).replace("\\\"", "\"").toUtf8().constData());
+    }
+
+private:
+    QList<PalmServiceBridge*> mBridges;
+    LatencyRecorder mRecorder;
+    qint64 mScriptCharacters;
+};
+
+class BusThroughputBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        // registers its handles on the fake bus
+        QVERIFY(LunaServiceManager::instance());
+    }
+
+    void calls_data()
+    {
+        QTest::addColumn<int>("latency");
+        QTest::addColumn<int>("replySize");
+        QTest::addColumn<int>("calls");
+
+        QTest::newRow("immediate, 128 bytes") << 0 << 128 << 2000;
+        QTest::newRow("immediate, 4 kB") << 0 << 4096 << 2000;
+        QTest::newRow("immediate, 64 kB") << 0 << 65536 << 500;
+        QTest::newRow("5 ms, 128 bytes") << 5 << 128 << 2000;
+    }
+
+    // One shot calls through LunaServiceManager; the latency is measured up
+    // to the listener on the GUI thread
+    void calls()
+    {
+        QFETCH(int, latency);
+        QFETCH(int, replySize);
+        QFETCH(int, calls);
+
+        FakeServiceMethod method(ECHO_URI);
+        method.latency = latency;
+        method.replySize = replySize;
+        FakeLunaBus::instance()->addMethod(method);
+
+        LatencyRecorder recorder;
+        QList<CountingListener*> listeners;
+        for (int n = 0; n < calls; n++)
+            listeners.append(new CountingListener(&recorder));
+
+        QElapsedTimer timer;
+        timer.start();
+
+        Q_FOREACH(CountingListener *listener, listeners)
+            LunaServiceManager::instance()->call(ECHO_URI, "{}", listener, BENCHMARK_APP_ID);
+
+        QVERIFY(waitFor([&]() { return recorder.count() == calls; }));
+
+        reportMetric("callsPerSecond", perSecond(calls, timer.nsecsElapsed()), "calls/s");
+        recorder.report();
+
+        Q_FOREACH(CountingListener *listener, listeners)
+            LunaServiceManager::instance()->cancel(listener);
+        qDeleteAll(listeners);
+    }
+
+    void palmServiceBridge_data()
+    {
+        calls_data();
+    }
+
+    // The same through PalmServiceBridge up to the script for the page
+    void palmServiceBridge()
+    {
+        QFETCH(int, latency);
+        QFETCH(int, replySize);
+        QFETCH(int, calls);
+
+        FakeServiceMethod method(ECHO_URI);
+        method.latency = latency;
+        method.replySize = replySize;
+        FakeLunaBus::instance()->addMethod(method);
+
+        BridgeSink sink;
+        for (int n = 0; n < calls; n++)
+            sink.createBridge();
+
+        QElapsedTimer timer;
+        timer.start();
+
+        Q_FOREACH(PalmServiceBridge *bridge, sink.bridges())
+            bridge->call(ECHO_URI, "{}");
+
+        QVERIFY(waitFor([&]() { return sink.recorder().count() == calls; }));
+
+        reportMetric("callsPerSecond", perSecond(calls, timer.nsecsElapsed()), "calls/s");
+        sink.recorder().report();
+    }
+
+    void subscriptions_data()
+    {
+        QTest::addColumn<int>("subscriptions");
+        QTest::addColumn<int>("interval");
+        QTest::addColumn<int>("replySize");
+
+        QTest::newRow("100 at 50 Hz, 1 kB") << 100 << 20 << 1024;
+        QTest::newRow("20 at 100 Hz, 16 kB") << 20 << 10 << 16384;
+        QTest::newRow("500 at 10 Hz, 256 bytes") << 500 << 100 << 256;
+    }
+
+    // Sustained subscription load through PalmServiceBridge: how many
+    // replies reach the page, how late they are and whether memory grows
+    void subscriptions()
+    {
+        QFETCH(int, subscriptions);
+        QFETCH(int, interval);
+        QFETCH(int, replySize);
+
+        FakeServiceMethod method(SUBSCRIPTION_URI);
+        method.replySize = replySize;
+        method.subscriptionInterval = interval;
+        FakeLunaBus::instance()->addMethod(method);
+
+        BridgeSink sink;
+        for (int n = 0; n < subscriptions; n++)
+            sink.createBridge();
+
+        Q_FOREACH(PalmServiceBridge *bridge, sink.bridges())
+            bridge->call(SUBSCRIPTION_URI, "{\"subscribe\":true}");
+
+        QElapsedTimer timer;
+        timer.start();
+        QVERIFY(waitFor([&]() { return timer.elapsed() >= WARMUP_MS; }));
+
+        qint64 memoryBefore = residentMemory();
+        sink.reset();
+        FakeLunaBus::instance()->resetStatistics();
+
+        timer.restart();
+        QVERIFY(waitFor([&]() { return timer.elapsed() >= SUSTAINED_LOAD_MS; }));
+        qint64 elapsed = timer.nsecsElapsed();
+
+        FakeLunaBus::Statistics statistics = FakeLunaBus::instance()->statistics();
+        qint64 memoryAfter = residentMemory();
+
+        reportMetric("repliesSentPerSecond", perSecond(statistics.replies, elapsed), "replies/s");
+        reportMetric("repliesDeliveredPerSecond", perSecond(sink.recorder().count(), elapsed), "replies/s");
+        reportMetric("replyBytesPerSecond", perSecond(statistics.replyBytes, elapsed), "bytes/s");
+        reportMetric("scriptCharactersPerSecond", perSecond(sink.scriptCharacters(), elapsed), "characters/s");
+        reportMetric("memoryGrowth", memoryAfter - memoryBefore, "kB");
+        sink.recorder().report();
+
+        Q_FOREACH(PalmServiceBridge *bridge, sink.bridges())
+            bridge->cancel();
+
+        QCOMPARE(FakeLunaBus::instance()->statistics().activeCalls, 0);
+    }
+
+    void activity_data()
+    {
+        QTest::addColumn<int>("count");
+
+        QTest::newRow("50 activities") << 50;
+        QTest::newRow("500 activities") << 500;
+    }
+
+    void activity()
+    {
+        QFETCH(int, count);
+
+        FakeServiceMethod create("palm://com.palm.activitymanager/create");
+        create.reply.insert("activityId", 42);
+        create.latency = 1;
+        FakeLunaBus::instance()->addMethod(create);
+        FakeLunaBus::instance()->addMethod(FakeServiceMethod("palm://com.palm.activitymanager/focus"));
+        FakeLunaBus::instance()->addMethod(FakeServiceMethod("palm://com.palm.activitymanager/unfocus"));
+
+        QList<Activity*> activities;
+
+        QElapsedTimer timer;
+        timer.start();
+
+        for (int n = 0; n < count; n++)
+            activities.append(new Activity(BENCHMARK_APP_ID, BENCHMARK_APP_ID, QString::number(n)));
+
+        QVERIFY(waitFor([&]() {
+            Q_FOREACH(Activity *activity, activities) {
+                if (activity->id() < 0)
+                    return false;
+            }
+            return true;
+        }));
+
+        reportMetric("activitiesCreatedPerSecond", perSecond(count, timer.nsecsElapsed()), "activities/s");
+
+        // focus changes don't wait for a reply so this is the cost of the call
+        timer.restart();
+        Q_FOREACH(Activity *activity, activities) {
+            activity->focus();
+            activity->unfocus();
+        }
+        reportMetric("focusChangesPerSecond", perSecond(2 * count, timer.nsecsElapsed()), "calls/s");
+
+        qDeleteAll(activities);
+    }
+
+    // Keeps running till the end so it has to stay the last one
+    void systemTime()
+    {
+        FakeServiceMethod time("luna://com.palm.systemservice/time/getSystemTime");
+        time.reply.insert("timezone", QString("Europe/Berlin"));
+        time.replySize = 512;
+        time.subscriptionInterval = 10;
+        FakeLunaBus::instance()->addMethod(time);
+
+        SystemTime *systemTime = SystemTime::instance();
+        QVERIFY(waitFor([&]() { return systemTime->timezone() == "Europe/Berlin"; }));
+
+        qint64 memoryBefore = residentMemory();
+        FakeLunaBus::instance()->resetStatistics();
+
+        QElapsedTimer timer;
+        timer.start();
+        QVERIFY(waitFor([&]() { return timer.elapsed() >= SUSTAINED_LOAD_MS; }));
+        qint64 elapsed = timer.nsecsElapsed();
+
+        FakeLunaBus::Statistics statistics = FakeLunaBus::instance()->statistics();
+
+        reportMetric("updatesPerSecond", perSecond(statistics.replies, elapsed), "updates/s");
+        reportMetric("memoryGrowth", residentMemory() - memoryBefore, "kB");
+    }
+};
+
+BENCHMARK_MAIN(BusThroughputBenchmark, "busthroughput")
+
+#include "busthroughputbenchmark.moc"
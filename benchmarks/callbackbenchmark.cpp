@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QUrl>
+
+#include <applicationenvironment.h>
+#include <baseextension.h>
+
+#include "benchmarkrunner.h"
+
+using namespace luna;
+
+/*
+ * Swallows the scripts; keeping the size around makes sure the callback
+ * isn't optimized away.
+ */
+class NullEnvironment : public ApplicationEnvironment
+{
+public:
+    NullEnvironment() : mBytes(0) { }
+
+    void executeScript(const QString &script) { mBytes += script.size(); }
+    void registerUserScript(const QUrl &path) { Q_UNUSED(path); }
+
+    qint64 bytes() const { return mBytes; }
+
+private:
+    qint64 mBytes;
+};
+
+class CallbackExtension : public BaseExtension
+{
+public:
+    explicit CallbackExtension(ApplicationEnvironment *environment) :
+        BaseExtension("Callback", environment)
+    {
+    }
+
+    using BaseExtension::callback;
+    using BaseExtension::callbackWithoutRemove;
+    using BaseExtension::callbackWithValue;
+    using BaseExtension::callbackWithInteger;
+    using BaseExtension::callbackWithJson;
+    using BaseExtension::KeepCallback;
+};
+
+static QJsonObject response(int entries)
+{
+    QJsonObject object;
+    object.insert("returnValue", true);
+
+    QJsonArray results;
+    for (int n = 0; n < entries; n++) {
+        QJsonObject result;
+        result.insert("_id", QString("++HzCdkW%1").arg(n));
+        result.insert("name", QString("Entry \"%1\"").arg(n));
+        result.insert("value", n * 1.5);
+        results.append(result);
+    }
+    object.insert("results", results);
+
+    return object;
+}
+
+class CallbackBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void payload_data()
+    {
+        QTest::addColumn<QJsonObject>("payload");
+
+        QTest::newRow("small") << response(1);
+        QTest::newRow("large") << response(200);
+    }
+
+    void callbackString_data() { payload_data(); }
+
+    // the old way: serialize to a QString first and hand that over
+    void callbackString()
+    {
+        QFETCH(QJsonObject, payload);
+        NullEnvironment environment;
+        CallbackExtension extension(&environment);
+
+        QBENCHMARK {
+            QString parameters = QString::fromUtf8(QJsonDocument(payload).toJson(QJsonDocument::Compact));
+            extension.callback(42, parameters);
+        }
+
+        QVERIFY(environment.bytes() > 0);
+    }
+
+    void callbackWithValue_data() { payload_data(); }
+
+    void callbackWithValue()
+    {
+        QFETCH(QJsonObject, payload);
+        NullEnvironment environment;
+        CallbackExtension extension(&environment);
+
+        QBENCHMARK {
+            extension.callbackWithValue(42, payload);
+        }
+
+        QVERIFY(environment.bytes() > 0);
+    }
+
+    void callbackWithJson_data() { payload_data(); }
+
+    void callbackWithJson()
+    {
+        QFETCH(QJsonObject, payload);
+        NullEnvironment environment;
+        CallbackExtension extension(&environment);
+        QByteArray json = QJsonDocument(payload).toJson(QJsonDocument::Compact);
+
+        QBENCHMARK {
+            extension.callbackWithJson(42, json, CallbackExtension::KeepCallback);
+        }
+
+        QVERIFY(environment.bytes() > 0);
+    }
+
+    void callbackWithString()
+    {
+        NullEnvironment environment;
+        CallbackExtension extension(&environment);
+        QJsonValue value(QString("a \"quoted\" string with\nnewlines and unicode äöü"));
+
+        QBENCHMARK {
+            extension.callbackWithValue(42, value);
+        }
+
+        QVERIFY(environment.bytes() > 0);
+    }
+
+    void callbackWithInteger()
+    {
+        NullEnvironment environment;
+        CallbackExtension extension(&environment);
+
+        QBENCHMARK {
+            extension.callbackWithInteger(42, Q_INT64_C(1403251200000));
+        }
+
+        QVERIFY(environment.bytes() > 0);
+    }
+
+    void callbackWithoutParameters()
+    {
+        NullEnvironment environment;
+        CallbackExtension extension(&environment);
+
+        QBENCHMARK {
+            extension.callbackWithoutRemove(42, QString());
+        }
+
+        QVERIFY(environment.bytes() > 0);
+    }
+};
+
+BENCHMARK_MAIN(CallbackBenchmark, "callback")
+
+#include "callbackbenchmark.moc"
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QFile>
+#include <QJSEngine>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "benchmarkrunner.h"
+
+using namespace luna;
+
+/*
+ * Stands in for WebApplicationWindow; accepts every call like a GUI thread
+ * extension without any work behind it.
+ */
+class WindowStub : public QObject
+{
+    Q_OBJECT
+
+public:
+    WindowStub() : mCalls(0), mLoads(0) { }
+
+    Q_INVOKABLE void loadExtension(const QString &name)
+    {
+        Q_UNUSED(name);
+        mLoads++;
+    }
+
+    Q_INVOKABLE bool dispatchExtensionCall(const QString &name, const QString &funcName,
+                                           const QVariantList &params, bool hasCallbacks, int bytesIn)
+    {
+        Q_UNUSED(name);
+        Q_UNUSED(funcName);
+        Q_UNUSED(params);
+        Q_UNUSED(hasCallbacks);
+        Q_UNUSED(bytesIn);
+        mCalls++;
+        return true;
+    }
+
+    int calls() const { return mCalls; }
+    int loads() const { return mLoads; }
+
+private:
+    int mCalls;
+    int mLoads;
+};
+
+static QString message(const QString &func, const QJsonArray &params)
+{
+    QJsonObject object;
+    object.insert("messageType", QString("callExtensionFunction"));
+    object.insert("extension", QString("PalmServiceBridge"));
+    object.insert("func", func);
+    object.insert("params", params);
+    object.insert("hasCallbacks", true);
+
+    return QString::fromUtf8(QJsonDocument(object).toJson(QJsonDocument::Compact));
+}
+
+class ExtensionManagerBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QFile script(EXTENSION_MANAGER_SCRIPT);
+        QVERIFY(script.open(QIODevice::ReadOnly));
+
+        mEngine.globalObject().setProperty("webAppWindow", mEngine.newQObject(&mWindow));
+
+        QJSValue result = mEngine.evaluate(QString::fromUtf8(script.readAll()), EXTENSION_MANAGER_SCRIPT);
+        QVERIFY(!result.isError());
+
+        // the extension object is only checked for existence
+        mEngine.globalObject().property("addExtension")
+            .call(QJSValueList() << QJSValue("PalmServiceBridge") << mEngine.newObject());
+
+        mMessageHandler = mEngine.globalObject().property("messageHandler");
+        QVERIFY(mMessageHandler.isCallable());
+    }
+
+    void messageHandler_data()
+    {
+        QTest::addColumn<QString>("data");
+
+        QTest::newRow("call") << message("call", QJsonArray() << 1
+                                         << QString("luna://com.palm.systemservice/time/getSystemTime")
+                                         << QString("{\"subscribe\":true}"));
+
+        QJsonObject query;
+        QJsonArray where;
+        for (int n = 0; n < 50; n++) {
+            QJsonObject clause;
+            clause.insert("prop", QString("property%1").arg(n));
+            clause.insert("op", QString("="));
+            clause.insert("val", QString("some value to compare with %1").arg(n));
+            where.append(clause);
+        }
+        query.insert("where", where);
+        QTest::newRow("large") << message("call", QJsonArray() << 2
+                                          << QString("luna://com.palm.db/find")
+                                          << QString::fromUtf8(QJsonDocument(query).toJson()));
+    }
+
+    void messageHandler()
+    {
+        QFETCH(QString, data);
+
+        QJSValue message = mEngine.newObject();
+        message.setProperty("data", data);
+        QJSValueList arguments;
+        arguments << message;
+
+        int calls = mWindow.calls();
+        QBENCHMARK {
+            mMessageHandler.call(arguments);
+        }
+
+        QVERIFY(mWindow.calls() > calls);
+        QCOMPARE(mWindow.loads(), 0);
+    }
+
+    void ignoredMessage()
+    {
+        QJSValue message = mEngine.newObject();
+        message.setProperty("data", QString("{\"messageType\":\"somethingElse\"}"));
+        QJSValueList arguments;
+        arguments << message;
+
+        QBENCHMARK {
+            mMessageHandler.call(arguments);
+        }
+    }
+
+private:
+    QJSEngine mEngine;
+    WindowStub mWindow;
+    QJSValue mMessageHandler;
+};
+
+BENCHMARK_MAIN(ExtensionManagerBenchmark, "extensionmanager")
+
+#include "extensionmanagerbenchmark.moc"
@@ -0,0 +1,801 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonDocument>
+#include <QSet>
+
+#include <errno.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <string>
+
+#include <luna-service2/lunaservice.h>
+
+#include "fakelunabus.h"
+
+/*
+ * The handle and message types are opaque in the luna-service2 headers so
+ * we're free to define them the way the fake bus needs them.
+ */
+struct LSHandle
+{
+    std::string name;
+    bool publicBus;
+    // replies are dispatched here; the default context until attached
+    GMainContext *context;
+    int priority;
+};
+
+struct LSPalmService
+{
+    LSHandle *publicHandle;
+    LSHandle *privateHandle;
+};
+
+struct LSMessage
+{
+    std::atomic<int> refs;
+    LSHandle *handle;
+    LSMessageToken responseToken;
+    bool subscription;
+    std::string payload;
+    // copies, a message may outlive the call it belongs to
+    std::string sender;
+    std::string category;
+    std::string method;
+};
+
+namespace luna
+{
+
+/*
+ * A scripted method with everything precomputed which is needed to build a
+ * reply. The body is the JSON object of the static reply fields without its
+ * opening brace; the per reply fields are put in front of it.
+ */
+struct ScriptedMethod
+{
+    FakeServiceMethod method;
+    std::string sender;
+    std::string category;
+    std::string name;
+    std::string body;
+};
+
+struct FakeCall
+{
+    LSHandle *handle;
+    LSMessageToken token;
+    LSFilterFunc callback;
+    void *context;
+    bool oneReply;
+    bool subscription;
+    bool cancelled;
+    int sequence;
+    GSource *source;
+    ScriptedMethod method;
+};
+
+struct FakeServerStatus
+{
+    LSHandle *handle;
+    std::string service;
+    LSServerStatusFunc callback;
+    void *context;
+    GSource *source;
+    bool cancelled;
+    int refs;
+};
+
+// Protects all of the bus state. It's held while a reply is delivered so a
+// call canceled from another thread never sees a reply after LSCallCancel.
+static GRecMutex busLock;
+static QHash<QByteArray, ScriptedMethod> methods;
+static QSet<QByteArray> services;
+static QHash<LSMessageToken, FakeCall*> calls;
+static LSMessageToken lastToken = 0;
+static FakeLunaBus::Statistics statistics = { 0, 0, 0, 0, 0 };
+
+#define setError(lserror, code, text) \
+    setErrorAt(lserror, code, text, __FILE__, __LINE__, __func__)
+
+static void setErrorAt(LSError *lserror, int code, const char *text,
+                       const char *file, int line, const char *func)
+{
+    if (!lserror)
+        return;
+
+    lserror->error_code = code;
+    lserror->message = g_strdup(text);
+    lserror->file = file;
+    lserror->line = line;
+    lserror->func = func;
+}
+
+/*
+ * luna://com.palm.systemservice/time/getSystemTime addresses the method
+ * getSystemTime in the category /time of the service com.palm.systemservice.
+ */
+static QByteArray methodKey(const char *uri)
+{
+    const char *path = strstr(uri, "://");
+    return QByteArray(path ? path + 3 : uri);
+}
+
+static ScriptedMethod scriptMethod(const QByteArray &key, const FakeServiceMethod &method, const QByteArray &body)
+{
+    ScriptedMethod scripted;
+    scripted.method = method;
+    scripted.body = std::string(body.constData() + 1, body.size() - 1);
+
+    int serviceEnd = key.indexOf('/');
+    int methodStart = key.lastIndexOf('/');
+
+    scripted.sender = key.left(serviceEnd < 0 ? key.size() : serviceEnd).constData();
+    if (serviceEnd >= 0 && methodStart > serviceEnd)
+        scripted.category = key.mid(serviceEnd, methodStart - serviceEnd).constData();
+    else
+        scripted.category = "/";
+    if (methodStart >= 0)
+        scripted.name = key.mid(methodStart + 1).constData();
+
+    return scripted;
+}
+
+static ScriptedMethod findMethod(const char *uri)
+{
+    QByteArray key = methodKey(uri);
+
+    QHash<QByteArray, ScriptedMethod>::const_iterator method = methods.constFind(key);
+    if (method != methods.constEnd())
+        return method.value();
+
+    // the hub answers calls to unknown methods with an error reply
+    FakeServiceMethod unknown(uri);
+    return scriptMethod(key, unknown,
+                        "{\"returnValue\":false,\"errorCode\":-1,\"errorText\":\"Unknown method\"}");
+}
+
+static bool isSubscription(const char *payload)
+{
+    const char *key = strstr(payload, "\"subscribe\"");
+    if (!key)
+        return false;
+
+    const char *value = key + strlen("\"subscribe\"");
+    while (*value == ' ' || *value == ':')
+        value++;
+
+    return strncmp(value, "true", 4) == 0;
+}
+
+static LSHandle* createHandle(const char *name, bool publicBus)
+{
+    LSHandle *handle = new LSHandle;
+    handle->name = name ? name : "";
+    handle->publicBus = publicBus;
+    handle->context = 0;
+    handle->priority = G_PRIORITY_DEFAULT;
+    return handle;
+}
+
+static void attachHandle(LSHandle *handle, GMainContext *context)
+{
+    if (handle->context)
+        g_main_context_unref(handle->context);
+
+    handle->context = context ? g_main_context_ref(context) : 0;
+}
+
+static void cancelCall(FakeCall *call)
+{
+    calls.remove(call->token);
+    statistics.cancelled++;
+
+    // the call is freed once the source is gone, which is either right away
+    // or after the reply which is being delivered right now
+    call->cancelled = true;
+    g_source_destroy(call->source);
+}
+
+static void destroyHandle(LSHandle *handle)
+{
+    g_rec_mutex_lock(&busLock);
+
+    Q_FOREACH(FakeCall *call, calls.values()) {
+        if (call->handle == handle)
+            cancelCall(call);
+    }
+
+    g_rec_mutex_unlock(&busLock);
+
+    attachHandle(handle, 0);
+    delete handle;
+}
+
+static LSMessage* createReply(FakeCall *call)
+{
+    static const char paddingStart[] = "\"padding\":\"";
+    static const char paddingEnd[] = "\",";
+
+    char header[64];
+    int length = snprintf(header, sizeof(header), "{\"sentAt\":%" G_GINT64_FORMAT ",\"sequence\":%d,",
+                          g_get_monotonic_time(), ++call->sequence);
+
+    const std::string &body = call->method.body;
+    int padding = call->method.method.replySize - length - (int) body.size()
+            - (int) (sizeof(paddingStart) - 1) - (int) (sizeof(paddingEnd) - 1);
+
+    LSMessage *message = new LSMessage;
+    message->refs.store(1);
+    message->handle = call->handle;
+    message->responseToken = call->token;
+    message->subscription = call->subscription;
+    message->sender = call->method.sender;
+    message->category = call->method.category;
+    message->method = call->method.name;
+
+    std::string &payload = message->payload;
+    payload.reserve(length + body.size() + (padding > 0 ? call->method.method.replySize : 0));
+    payload.append(header, length);
+    if (padding > 0) {
+        payload.append(paddingStart);
+        payload.append(padding, 'x');
+        payload.append(paddingEnd);
+    }
+    payload.append(body);
+
+    return message;
+}
+
+static gboolean deliverReply(gpointer data)
+{
+    FakeCall *call = static_cast<FakeCall*>(data);
+
+    g_rec_mutex_lock(&busLock);
+
+    if (call->cancelled) {
+        g_rec_mutex_unlock(&busLock);
+        return FALSE;
+    }
+
+    LSMessage *message = createReply(call);
+    statistics.replies++;
+    statistics.replyBytes += message->payload.size();
+
+    bool keep = !call->oneReply;
+    if (call->subscription && call->method.method.subscriptionInterval > 0) {
+        g_source_set_ready_time(call->source,
+                                g_get_monotonic_time() + call->method.method.subscriptionInterval * 1000);
+    }
+    else if (keep) {
+        // like on the real bus the call stays open until it's canceled
+        g_source_set_ready_time(call->source, -1);
+    }
+    else {
+        calls.remove(call->token);
+        call->cancelled = true;
+    }
+
+    if (call->callback)
+        call->callback(call->handle, message, call->context);
+
+    // the callback might have canceled the call
+    keep = keep && !call->cancelled;
+
+    g_rec_mutex_unlock(&busLock);
+
+    LSMessageUnref(message);
+
+    return keep;
+}
+
+static void releaseCall(gpointer data)
+{
+    delete static_cast<FakeCall*>(data);
+}
+
+static gboolean dispatchReplySource(GSource *source, GSourceFunc callback, gpointer data)
+{
+    Q_UNUSED(source);
+    return callback(data);
+}
+
+// Only woken up by its ready time which is set for every reply
+static GSourceFuncs replySourceFuncs = {
+    0,
+    0,
+    dispatchReplySource,
+    0,
+    0,
+    0
+};
+
+static bool startCall(LSHandle *sh, const char *uri, const char *payload, LSFilterFunc callback,
+                      void *context, bool oneReply, LSMessageToken *ret_token, LSError *lserror)
+{
+    if (!sh || !uri) {
+        setError(lserror, -EINVAL, "Invalid handle or uri");
+        return false;
+    }
+
+    g_rec_mutex_lock(&busLock);
+
+    FakeCall *call = new FakeCall;
+    call->handle = sh;
+    call->token = ++lastToken;
+    call->callback = callback;
+    call->context = context;
+    call->oneReply = oneReply;
+    call->subscription = !oneReply && payload && isSubscription(payload);
+    call->cancelled = false;
+    call->sequence = 0;
+    call->method = findMethod(uri);
+
+    GSource *source = g_source_new(&replySourceFuncs, sizeof(GSource));
+    g_source_set_callback(source, deliverReply, call, releaseCall);
+    g_source_set_priority(source, sh->priority);
+    g_source_set_ready_time(source, g_get_monotonic_time() + call->method.method.latency * 1000);
+    call->source = source;
+
+    calls.insert(call->token, call);
+    statistics.calls++;
+
+    LSMessageToken token = call->token;
+
+    g_source_attach(source, sh->context);
+    g_source_unref(source);
+
+    g_rec_mutex_unlock(&busLock);
+
+    if (ret_token)
+        *ret_token = token;
+
+    return true;
+}
+
+static void releaseServerStatus(gpointer data)
+{
+    FakeServerStatus *status = static_cast<FakeServerStatus*>(data);
+
+    g_rec_mutex_lock(&busLock);
+    bool last = (--status->refs == 0);
+    g_rec_mutex_unlock(&busLock);
+
+    if (last)
+        delete status;
+}
+
+static gboolean deliverServerStatus(gpointer data)
+{
+    FakeServerStatus *status = static_cast<FakeServerStatus*>(data);
+
+    g_rec_mutex_lock(&busLock);
+
+    status->source = 0;
+    if (!status->cancelled) {
+        bool connected = services.contains(QByteArray(status->service.c_str()));
+        status->callback(status->handle, status->service.c_str(), connected, status->context);
+    }
+
+    g_rec_mutex_unlock(&busLock);
+
+    return FALSE;
+}
+
+FakeServiceMethod::FakeServiceMethod(const QString &uri) :
+    uri(uri),
+    latency(0),
+    replySize(0),
+    subscriptionInterval(0)
+{
+}
+
+FakeLunaBus* FakeLunaBus::instance()
+{
+    static FakeLunaBus bus;
+    return &bus;
+}
+
+FakeLunaBus::FakeLunaBus()
+{
+}
+
+/**
+ * Adds or replaces a method. Calls which are already running keep the
+ * behaviour of the method at the time they were made.
+ */
+void FakeLunaBus::addMethod(const FakeServiceMethod &method)
+{
+    QJsonObject reply = method.reply;
+    if (!reply.contains("returnValue"))
+        reply.insert("returnValue", true);
+
+    QByteArray key = methodKey(method.uri.toUtf8().constData());
+    ScriptedMethod scripted = scriptMethod(key, method, QJsonDocument(reply).toJson(QJsonDocument::Compact));
+
+    g_rec_mutex_lock(&busLock);
+    methods.insert(key, scripted);
+    services.insert(QByteArray(scripted.sender.c_str()));
+    g_rec_mutex_unlock(&busLock);
+}
+
+void FakeLunaBus::removeMethod(const QString &uri)
+{
+    QByteArray key = methodKey(uri.toUtf8().constData());
+
+    g_rec_mutex_lock(&busLock);
+
+    methods.remove(key);
+
+    services.clear();
+    Q_FOREACH(const ScriptedMethod &method, methods)
+        services.insert(QByteArray(method.sender.c_str()));
+
+    g_rec_mutex_unlock(&busLock);
+}
+
+FakeLunaBus::Statistics FakeLunaBus::statistics() const
+{
+    g_rec_mutex_lock(&busLock);
+    Statistics result = luna::statistics;
+    result.activeCalls = calls.count();
+    g_rec_mutex_unlock(&busLock);
+
+    return result;
+}
+
+void FakeLunaBus::resetStatistics()
+{
+    g_rec_mutex_lock(&busLock);
+    luna::statistics.calls = 0;
+    luna::statistics.replies = 0;
+    luna::statistics.replyBytes = 0;
+    luna::statistics.cancelled = 0;
+    g_rec_mutex_unlock(&busLock);
+}
+
+qint64 FakeLunaBus::sentAt(const char *payload)
+{
+    static const char prefix[] = "{\"sentAt\":";
+
+    if (!payload || strncmp(payload, prefix, sizeof(prefix) - 1) != 0)
+        return -1;
+
+    return strtoll(payload + sizeof(prefix) - 1, 0, 10);
+}
+
+} // namespace luna
+
+using namespace luna;
+
+/*
+ * The part of the luna-service2 client API the launcher uses. Defining the
+ * symbols in the binary makes them take precedence over the library, for
+ * our own code as well as for libluna-service2++.
+ */
+extern "C" {
+
+bool LSErrorInit(LSError *lserror)
+{
+    memset(lserror, 0, sizeof(LSError));
+    return true;
+}
+
+void LSErrorFree(LSError *lserror)
+{
+    if (!lserror)
+        return;
+
+    g_free(lserror->message);
+    LSErrorInit(lserror);
+}
+
+bool LSErrorIsSet(LSError *lserror)
+{
+    return lserror && lserror->error_code != 0;
+}
+
+void LSErrorPrint(LSError *lserror, FILE *out)
+{
+    if (!LSErrorIsSet(lserror))
+        return;
+
+    fprintf(out, "LUNASERVICE ERROR %d: %s (%s @ %s:%d)\n", lserror->error_code,
+            lserror->message, lserror->func, lserror->file, lserror->line);
+}
+
+bool LSRegisterPubPriv(const char *name, LSHandle **sh, bool public_bus, LSError *lserror)
+{
+    Q_UNUSED(lserror);
+
+    *sh = createHandle(name, public_bus);
+    return true;
+}
+
+bool LSRegister(const char *name, LSHandle **sh, LSError *lserror)
+{
+    return LSRegisterPubPriv(name, sh, false, lserror);
+}
+
+bool LSUnregister(LSHandle *sh, LSError *lserror)
+{
+    Q_UNUSED(lserror);
+
+    destroyHandle(sh);
+    return true;
+}
+
+bool LSRegisterPalmService(const char *name, LSPalmService **ret_palm_service, LSError *lserror)
+{
+    Q_UNUSED(lserror);
+
+    LSPalmService *service = new LSPalmService;
+    service->publicHandle = createHandle(name, true);
+    service->privateHandle = createHandle(name, false);
+    *ret_palm_service = service;
+    return true;
+}
+
+bool LSUnregisterPalmService(LSPalmService *psh, LSError *lserror)
+{
+    Q_UNUSED(lserror);
+
+    destroyHandle(psh->publicHandle);
+    destroyHandle(psh->privateHandle);
+    delete psh;
+    return true;
+}
+
+LSHandle* LSPalmServiceGetPrivateConnection(LSPalmService *psh)
+{
+    return psh->privateHandle;
+}
+
+LSHandle* LSPalmServiceGetPublicConnection(LSPalmService *psh)
+{
+    return psh->publicHandle;
+}
+
+bool LSGmainAttach(LSHandle *sh, GMainLoop *mainLoop, LSError *lserror)
+{
+    Q_UNUSED(lserror);
+
+    attachHandle(sh, g_main_loop_get_context(mainLoop));
+    return true;
+}
+
+bool LSGmainContextAttach(LSHandle *sh, GMainContext *mainContext, LSError *lserror)
+{
+    Q_UNUSED(lserror);
+
+    attachHandle(sh, mainContext);
+    return true;
+}
+
+bool LSGmainAttachPalmService(LSPalmService *psh, GMainLoop *mainLoop, LSError *lserror)
+{
+    return LSGmainAttach(psh->publicHandle, mainLoop, lserror) &&
+           LSGmainAttach(psh->privateHandle, mainLoop, lserror);
+}
+
+bool LSGmainSetPriority(LSHandle *sh, int priority, LSError *lserror)
+{
+    Q_UNUSED(lserror);
+
+    sh->priority = priority;
+    return true;
+}
+
+bool LSRegisterCategory(LSHandle *sh, const char *category, LSMethod *methods,
+                        LSSignal *ls_signals, LSProperty *properties, LSError *lserror)
+{
+    // Nobody calls the services of the launcher over the fake bus
+    Q_UNUSED(sh);
+    Q_UNUSED(category);
+    Q_UNUSED(methods);
+    Q_UNUSED(ls_signals);
+    Q_UNUSED(properties);
+    Q_UNUSED(lserror);
+    return true;
+}
+
+bool LSCategorySetData(LSHandle *sh, const char *category, void *user_data, LSError *lserror)
+{
+    Q_UNUSED(sh);
+    Q_UNUSED(category);
+    Q_UNUSED(user_data);
+    Q_UNUSED(lserror);
+    return true;
+}
+
+bool LSCall(LSHandle *sh, const char *uri, const char *payload, LSFilterFunc callback,
+            void *user_data, LSMessageToken *ret_token, LSError *lserror)
+{
+    return startCall(sh, uri, payload, callback, user_data, false, ret_token, lserror);
+}
+
+bool LSCallOneReply(LSHandle *sh, const char *uri, const char *payload, LSFilterFunc callback,
+                    void *user_data, LSMessageToken *ret_token, LSError *lserror)
+{
+    return startCall(sh, uri, payload, callback, user_data, true, ret_token, lserror);
+}
+
+bool LSCallFromApplication(LSHandle *sh, const char *uri, const char *payload, const char *applicationID,
+                           LSFilterFunc callback, void *ctx, LSMessageToken *ret_token, LSError *lserror)
+{
+    Q_UNUSED(applicationID);
+    return startCall(sh, uri, payload, callback, ctx, false, ret_token, lserror);
+}
+
+bool LSCallFromApplicationOneReply(LSHandle *sh, const char *uri, const char *payload,
+                                   const char *applicationID, LSFilterFunc callback, void *ctx,
+                                   LSMessageToken *ret_token, LSError *lserror)
+{
+    Q_UNUSED(applicationID);
+    return startCall(sh, uri, payload, callback, ctx, true, ret_token, lserror);
+}
+
+bool LSCallCancel(LSHandle *sh, LSMessageToken token, LSError *lserror)
+{
+    Q_UNUSED(sh);
+
+    g_rec_mutex_lock(&busLock);
+
+    FakeCall *call = calls.value(token);
+    if (call)
+        cancelCall(call);
+
+    g_rec_mutex_unlock(&busLock);
+
+    if (!call) {
+        setError(lserror, -EINVAL, "No call with this token");
+        return false;
+    }
+
+    return true;
+}
+
+bool LSRegisterServerStatusEx(LSHandle *sh, const char *serviceName, LSServerStatusFunc func,
+                              void *ctxt, void **cookie, LSError *lserror)
+{
+    Q_UNUSED(lserror);
+
+    FakeServerStatus *status = new FakeServerStatus;
+    status->handle = sh;
+    status->service = serviceName;
+    status->callback = func;
+    status->context = ctxt;
+    status->cancelled = false;
+    // one reference for the source and one for the cookie
+    status->refs = cookie ? 2 : 1;
+
+    // the status is reported once; services don't come and go on the fake bus
+    GSource *source = g_idle_source_new();
+    g_source_set_callback(source, deliverServerStatus, status, releaseServerStatus);
+    g_source_set_priority(source, sh->priority);
+    status->source = source;
+
+    if (cookie)
+        *cookie = status;
+
+    g_source_attach(source, sh->context);
+    g_source_unref(source);
+
+    return true;
+}
+
+bool LSRegisterServerStatus(LSHandle *sh, const char *serviceName, LSServerStatusFunc func,
+                            void *ctx, LSError *lserror)
+{
+    return LSRegisterServerStatusEx(sh, serviceName, func, ctx, 0, lserror);
+}
+
+bool LSCancelServerStatus(LSHandle *sh, void *cookie, LSError *lserror)
+{
+    Q_UNUSED(sh);
+    Q_UNUSED(lserror);
+
+    FakeServerStatus *status = static_cast<FakeServerStatus*>(cookie);
+
+    g_rec_mutex_lock(&busLock);
+    status->cancelled = true;
+    if (status->source)
+        g_source_destroy(status->source);
+    g_rec_mutex_unlock(&busLock);
+
+    releaseServerStatus(status);
+    return true;
+}
+
+void LSMessageRef(LSMessage *message)
+{
+    message->refs++;
+}
+
+void LSMessageUnref(LSMessage *message)
+{
+    if (--message->refs == 0)
+        delete message;
+}
+
+LSHandle* LSMessageGetConnection(LSMessage *message)
+{
+    return message->handle;
+}
+
+const char* LSMessageGetPayload(LSMessage *message)
+{
+    return message->payload.c_str();
+}
+
+LSMessageToken LSMessageGetToken(LSMessage *message)
+{
+    return message->responseToken;
+}
+
+LSMessageToken LSMessageGetResponseToken(LSMessage *reply)
+{
+    return reply->responseToken;
+}
+
+const char* LSMessageGetSender(LSMessage *message)
+{
+    return message->sender.c_str();
+}
+
+const char* LSMessageGetSenderServiceName(LSMessage *message)
+{
+    return message->sender.c_str();
+}
+
+const char* LSMessageGetCategory(LSMessage *message)
+{
+    return message->category.c_str();
+}
+
+const char* LSMessageGetMethod(LSMessage *message)
+{
+    return message->method.c_str();
+}
+
+bool LSMessageIsSubscription(LSMessage *message)
+{
+    return message->subscription;
+}
+
+bool LSMessageReply(LSHandle *sh, LSMessage *lsmsg, const char *replyPayload, LSError *lserror)
+{
+    Q_UNUSED(sh);
+    Q_UNUSED(lsmsg);
+    Q_UNUSED(replyPayload);
+    Q_UNUSED(lserror);
+    return true;
+}
+
+bool LSMessageRespond(LSMessage *message, const char *reply_payload, LSError *lserror)
+{
+    return LSMessageReply(message->handle, message, reply_payload, lserror);
+}
+
+} // extern "C"
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef FAKELUNABUS_H
+#define FAKELUNABUS_H
+
+#include <QJsonObject>
+#include <QString>
+
+namespace luna
+{
+
+/**
+ * A method of a scripted service on the fake bus. Replies carry the fields of
+ * reply plus "returnValue", a "sequence" number per call and "sentAt", the
+ * g_get_monotonic_time() at which the bus sent the reply. They are padded to
+ * replySize bytes.
+ */
+struct FakeServiceMethod
+{
+    explicit FakeServiceMethod(const QString &uri = QString());
+
+    // luna:// and palm:// uris address the same method
+    QString uri;
+    QJsonObject reply;
+    // milliseconds until the first reply
+    int latency;
+    int replySize;
+    // milliseconds between the replies of a subscription; 0 replies only once
+    int subscriptionInterval;
+};
+
+/**
+ * In process stand-in for the luna bus. The luna-service2 client API used by
+ * the launcher is implemented in this file so a binary linking it talks to
+ * scripted services instead of the hub. Replies are dispatched on the main
+ * context the calling handle is attached to, like the real library does.
+ */
+class FakeLunaBus
+{
+public:
+    struct Statistics
+    {
+        quint64 calls;
+        quint64 replies;
+        quint64 replyBytes;
+        quint64 cancelled;
+        int activeCalls;
+    };
+
+    static FakeLunaBus* instance();
+
+    void addMethod(const FakeServiceMethod &method);
+    void removeMethod(const QString &uri);
+
+    Statistics statistics() const;
+    void resetStatistics();
+
+    // Returns the sentAt field of a reply sent by the bus or -1
+    static qint64 sentAt(const char *payload);
+
+private:
+    FakeLunaBus();
+};
+
+} // namespace luna
+
+#endif // FAKELUNABUS_H
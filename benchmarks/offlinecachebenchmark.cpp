@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPointer>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTimer>
+
+#include <offlinecache.h>
+
+#include "benchmarkrunner.h"
+
+#define ENTRY_PAGE          "/index.html"
+#define WAIT_TIMEOUT_MS     60000
+#define DOCUMENT_ROUNDS     10
+
+using namespace luna;
+
+/*
+ * Stands in for the server of a remote application. Serves a fixed set of
+ * resources with an ETag each over plain HTTP/1.1 on localhost and answers
+ * conditional requests with 304. Every response can be delayed to get
+ * closer to a real network.
+ */
+class StandInServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    StandInServer() :
+        mLatency(0),
+        mRequests(0),
+        mBytesSent(0)
+    {
+        connect(&mServer, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+        mServer.listen(QHostAddress::LocalHost);
+    }
+
+    bool isListening() const { return mServer.isListening(); }
+    int requests() const { return mRequests; }
+    qint64 bytesSent() const { return mBytesSent; }
+
+    QUrl url(const QString &path) const
+    {
+        return QUrl(QString("http://127.0.0.1:%1%2").arg(mServer.serverPort()).arg(path));
+    }
+
+    void addResource(const QByteArray &path, const QByteArray &contentType, const QByteArray &body)
+    {
+        Resource resource;
+        resource.contentType = contentType;
+        resource.body = body;
+        resource.etag = "\"" + QCryptographicHash::hash(body, QCryptographicHash::Sha1).toHex() + "\"";
+        mResources.insert(path, resource);
+    }
+
+    void setLatency(int latency)
+    {
+        mLatency = latency;
+    }
+
+    void resetCounters()
+    {
+        mRequests = 0;
+        mBytesSent = 0;
+    }
+
+private Q_SLOTS:
+    void onNewConnection()
+    {
+        while (QTcpSocket *socket = mServer.nextPendingConnection()) {
+            connect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+            connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+        }
+    }
+
+    void onReadyRead()
+    {
+        QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+        QByteArray &buffer = mBuffers[socket];
+        buffer.append(socket->readAll());
+
+        // only GET requests without a body are coming in
+        int end;
+        while ((end = buffer.indexOf("\r\n\r\n")) >= 0) {
+            QByteArray request = buffer.left(end);
+            buffer.remove(0, end + 4);
+            respond(socket, request);
+        }
+    }
+
+    void onDisconnected()
+    {
+        QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+        mBuffers.remove(socket);
+        socket->deleteLater();
+    }
+
+private:
+    struct Resource
+    {
+        QByteArray contentType;
+        QByteArray body;
+        QByteArray etag;
+    };
+
+    void respond(QTcpSocket *socket, const QByteArray &request)
+    {
+        QList<QByteArray> lines = request.split('\n');
+        QByteArray path = lines.first().split(' ').value(1);
+
+        QByteArray ifNoneMatch;
+        Q_FOREACH(const QByteArray &line, lines) {
+            if (line.toLower().startsWith("if-none-match:"))
+                ifNoneMatch = line.mid(14).trimmed();
+        }
+
+        QByteArray response;
+        if (!mResources.contains(path)) {
+            response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        }
+        else {
+            const Resource &resource = mResources[path];
+
+            if (ifNoneMatch == resource.etag)
+                response = "HTTP/1.1 304 Not Modified\r\nETag: " + resource.etag + "\r\n\r\n";
+            else
+                response = "HTTP/1.1 200 OK\r\nContent-Type: " + resource.contentType +
+                           "\r\nContent-Length: " + QByteArray::number(resource.body.size()) +
+                           "\r\nETag: " + resource.etag + "\r\n\r\n" + resource.body;
+        }
+
+        mRequests++;
+        mBytesSent += response.size();
+
+        QPointer<QTcpSocket> target(socket);
+        QTimer::singleShot(mLatency, [target, response]() {
+            if (target)
+                target->write(response);
+        });
+    }
+
+    QTcpServer mServer;
+    QHash<QByteArray, Resource> mResources;
+    QHash<QTcpSocket*, QByteArray> mBuffers;
+    int mLatency;
+    int mRequests;
+    qint64 mBytesSent;
+};
+
+class OfflineCacheBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        // the cache goes below XDG_CACHE_HOME
+        QVERIFY(mCacheHome.isValid());
+        qputenv("XDG_CACHE_HOME", mCacheHome.path().toUtf8());
+
+        QVERIFY(mServer.isListening());
+
+        // An entry page the size of a typical mobile web app
+        QByteArray page = "<html><head>\n";
+        for (int n = 0; n < 8; n++) {
+            QByteArray path = "/js/module" + QByteArray::number(n) + ".js";
+            mServer.addResource(path, "application/javascript", QByteArray(40 * 1024, 'j'));
+            page += "<script src=\"" + path + "\"></script>\n";
+        }
+        for (int n = 0; n < 2; n++) {
+            QByteArray path = "/css/style" + QByteArray::number(n) + ".css";
+            mServer.addResource(path, "text/css", QByteArray(20 * 1024, 'c'));
+            page += "<link rel=\"stylesheet\" href=\"" + path + "\">\n";
+        }
+        page += "</head><body>\n";
+        for (int n = 0; n < 10; n++) {
+            QByteArray path = "/images/image" + QByteArray::number(n) + ".png";
+            mServer.addResource(path, "image/png", QByteArray(30 * 1024, 'i'));
+            page += "<img src=\"" + path + "\">\n";
+        }
+        page += QByteArray(16 * 1024, ' ') + "</body></html>\n";
+
+        mServer.addResource(ENTRY_PAGE, "text/html", page);
+    }
+
+    void revalidate_data()
+    {
+        QTest::addColumn<int>("latency");
+
+        QTest::newRow("localhost") << 0;
+        QTest::newRow("20 ms per response") << 20;
+    }
+
+    // A cold cache fetches the entry page and everything it references, a
+    // warm one only sends conditional requests which are answered with 304
+    void revalidate()
+    {
+        QFETCH(int, latency);
+
+        mServer.setLatency(latency);
+        QString appId = QString("org.webosports.benchmark.revalidate%1").arg(latency);
+
+        qint64 cold = revalidateOnce(appId);
+        QVERIFY(cold >= 0);
+        reportMetric("coldTime", cold, "ms");
+        reportMetric("coldRequests", mServer.requests(), "requests");
+        reportMetric("coldBytes", mServer.bytesSent(), "bytes");
+
+        qint64 warm = revalidateOnce(appId);
+        QVERIFY(warm >= 0);
+        reportMetric("warmTime", warm, "ms");
+        reportMetric("warmRequests", mServer.requests(), "requests");
+        reportMetric("warmBytes", mServer.bytesSent(), "bytes");
+    }
+
+    // What an offline launch waits for before the page can be loaded
+    void prepareOfflineDocument()
+    {
+        mServer.setLatency(0);
+        QString appId("org.webosports.benchmark.document");
+        QVERIFY(revalidateOnce(appId) >= 0);
+
+        OfflineCache cache(appId, mServer.url(ENTRY_PAGE));
+        QVERIFY(cache.isAvailable());
+
+        QSignalSpy ready(&cache, SIGNAL(offlineDocumentReady(QString)));
+        qint64 total = 0;
+
+        for (int n = 0; n < DOCUMENT_ROUNDS; n++) {
+            QElapsedTimer timer;
+            timer.start();
+
+            cache.prepareOfflineDocument();
+            QVERIFY(ready.wait(WAIT_TIMEOUT_MS));
+
+            total += timer.nsecsElapsed();
+        }
+
+        QString document = ready.last().first().toString();
+        QVERIFY(document.contains("data:application/javascript;base64,"));
+
+        reportMetric("preparationTime", total / DOCUMENT_ROUNDS / 1000000.0, "ms");
+        reportMetric("documentSize", document.size(), "characters");
+    }
+
+private:
+    // Runs one revalidation with a fresh cache object the way a launch does,
+    // returns how long it took in ms or -1 if it didn't finish
+    qint64 revalidateOnce(const QString &appId)
+    {
+        OfflineCache cache(appId, mServer.url(ENTRY_PAGE));
+        QSignalSpy revalidated(&cache, SIGNAL(revalidated()));
+
+        mServer.resetCounters();
+
+        QElapsedTimer timer;
+        timer.start();
+
+        cache.revalidate();
+        if (!revalidated.wait(WAIT_TIMEOUT_MS))
+            return -1;
+
+        return timer.elapsed();
+    }
+
+    QTemporaryDir mCacheHome;
+    StandInServer mServer;
+};
+
+BENCHMARK_MAIN(OfflineCacheBenchmark, "offlinecache")
+
+#include "offlinecachebenchmark.moc"
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <extensions/palmsystemextension.h>
+
+#include "benchmarkrunner.h"
+
+using namespace luna;
+
+class PalmSystemBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void propertyFromName_data()
+    {
+        QTest::addColumn<QString>("name");
+
+        QTest::newRow("first") << QString("launchParams");
+        QTest::newRow("last") << QString("version");
+        QTest::newRow("alias") << QString("locales.UI");
+        QTest::newRow("unknown") << QString("doesNotExist");
+    }
+
+    void propertyFromName()
+    {
+        QFETCH(QString, name);
+
+        QBENCHMARK {
+            PalmSystemExtension::propertyFromName(name);
+        }
+    }
+
+    // What frameworks ask for while they start up
+    void startupProperties()
+    {
+        QStringList names;
+        names << "launchParams" << "deviceInfo" << "locale" << "localeRegion"
+              << "phoneRegion" << "timeFormat" << "timezone" << "identifier"
+              << "isActivated" << "activityId" << "windowOrientation" << "version";
+
+        int known = 0;
+        QBENCHMARK {
+            Q_FOREACH(const QString &name, names) {
+                if (PalmSystemExtension::propertyFromName(name) != PalmSystemExtension::UnknownProperty)
+                    known++;
+            }
+        }
+
+        QVERIFY(known > 0);
+    }
+
+    void synchronousFunctionFromName_data()
+    {
+        QTest::addColumn<QString>("name");
+
+        QTest::newRow("getProperty") << QString("getProperty");
+        QTest::newRow("getResource") << QString("getResource");
+        QTest::newRow("addBannerMessage") << QString("addBannerMessage");
+        QTest::newRow("unknown") << QString("doesNotExist");
+    }
+
+    void synchronousFunctionFromName()
+    {
+        QFETCH(QString, name);
+
+        QBENCHMARK {
+            PalmSystemExtension::synchronousFunctionFromName(name);
+        }
+    }
+};
+
+BENCHMARK_MAIN(PalmSystemBenchmark, "palmsystem")
+
+#include "palmsystembenchmark.moc"
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <resourcepathvalidator.h>
+
+#include "benchmarkrunner.h"
+
+using namespace luna;
+
+/*
+ * Paths as they show up in getResource calls: framework files, files of the
+ * application itself, media and a few which are rejected.
+ */
+static QStringList realisticPaths()
+{
+    QStringList paths;
+
+    paths << "/usr/palm/frameworks/enyo/1.0/framework/enyo.js"
+          << "/usr/palm/frameworks/mojo/submissions/200.72/javascripts/mojo.js"
+          << "/usr/palm/applications/com.palm.app.email/app/views/main.html"
+          << "/usr/palm/applications/com.palm.app.contacts/sharedWidgets/widget.js"
+          << "/media/cryptofs/apps/usr/palm/applications/com.example.game/index.html"
+          << "/media/cryptofs/apps/usr/palm/applications/com.palm.facebook/app.js"
+          << "/var/usr/palm/applications/com.example.notes/resources/en/strings.json"
+          << "/media/internal/downloads/picture.jpg"
+          << "/usr/lib/luna/system/luna-systemui/app/FilePicker/picker.js"
+          << "/var/file-cache/thumbnails/0001.png"
+          << "/etc/passwd"
+          << "/var/luna/preferences/private.db";
+
+    return paths;
+}
+
+class ResourcePathBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void validate_data()
+    {
+        QTest::addColumn<bool>("privileged");
+
+        QTest::newRow("privileged") << true;
+        QTest::newRow("unprivileged") << false;
+    }
+
+    void validate()
+    {
+        QFETCH(bool, privileged);
+
+        QStringList paths = realisticPaths();
+        ResourcePathValidator &validator = ResourcePathValidator::instance();
+
+        int allowed = 0;
+        QBENCHMARK {
+            Q_FOREACH(const QString &path, paths) {
+                if (validator.validate(path, privileged))
+                    allowed++;
+            }
+        }
+
+        QVERIFY(allowed > 0);
+    }
+
+    void rejected()
+    {
+        ResourcePathValidator &validator = ResourcePathValidator::instance();
+
+        // has to walk all the lists before it's rejected
+        QBENCHMARK {
+            validator.validate("/home/root/.ssh/authorized_keys", false);
+        }
+    }
+};
+
+BENCHMARK_MAIN(ResourcePathBenchmark, "resourcepath")
+
+#include "resourcepathbenchmark.moc"
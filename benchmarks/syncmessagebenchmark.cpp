@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <syncmessage.h>
+
+#include "benchmarkrunner.h"
+
+using namespace luna;
+
+static QString message(const QString &extension, const QString &func, const QJsonArray &params)
+{
+    QJsonObject object;
+    object.insert("messageType", QString("callSyncExtensionFunction"));
+    object.insert("extension", extension);
+    object.insert("func", func);
+    object.insert("params", params);
+
+    return QString::fromUtf8(QJsonDocument(object).toJson(QJsonDocument::Compact));
+}
+
+class SyncMessageBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void messages_data()
+    {
+        QTest::addColumn<QString>("data");
+
+        QTest::newRow("getProperty") << message("PalmSystem", "getProperty",
+                                                QJsonArray() << QString("launchParams"));
+
+        QJsonArray banner;
+        banner << QString("You have a new message") << QString("{\"id\": 42}")
+               << QString("images/notification.png") << QString("alerts")
+               << QString("") << 5 << false;
+        QTest::newRow("addBannerMessage") << message("PalmSystem", "addBannerMessage", banner);
+
+        QJsonArray large;
+        for (int n = 0; n < 100; n++)
+            large << QString("parameter number %1 with some text").arg(n);
+        QTest::newRow("large") << message("Example", "store", large);
+    }
+
+    void decode_data() { messages_data(); }
+
+    void decode()
+    {
+        QFETCH(QString, data);
+
+        bool decoded = false;
+        QBENCHMARK {
+            SyncMessage message;
+            decoded = SyncMessage::decode(data, message);
+        }
+
+        QVERIFY(decoded);
+    }
+
+    void decodeQJsonDocument_data() { messages_data(); }
+
+    // the decoding as done before the reader was used, for comparison
+    void decodeQJsonDocument()
+    {
+        QFETCH(QString, data);
+
+        bool decoded = false;
+        QBENCHMARK {
+            QJsonObject object = QJsonDocument::fromJson(data.toUtf8()).object();
+            decoded = object.value("messageType").toString() == "callSyncExtensionFunction";
+            QString extension = object.value("extension").toString();
+            QString func = object.value("func").toString();
+            QJsonArray params = object.value("params").toArray();
+            Q_UNUSED(extension);
+            Q_UNUSED(func);
+        }
+
+        QVERIFY(decoded);
+    }
+
+    void decodeInvalid()
+    {
+        QString data("{\"messageType\": \"somethingElse\", \"data\": 42}");
+
+        QBENCHMARK {
+            SyncMessage message;
+            SyncMessage::decode(data, message);
+        }
+    }
+};
+
+BENCHMARK_MAIN(SyncMessageBenchmark, "syncmessage")
+
+#include "syncmessagebenchmark.moc"
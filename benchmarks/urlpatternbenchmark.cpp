@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <urlpatternmatcher.h>
+
+#include "benchmarkrunner.h"
+
+using namespace luna;
+
+static QStringList patterns(int count)
+{
+    QStringList patterns;
+    for (int n = 0; n < count; n++)
+        patterns << QString("^https://([a-z]+\\.)?service%1\\.example\\.com/api/").arg(n);
+    return patterns;
+}
+
+class UrlPatternBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void matches_data()
+    {
+        QTest::addColumn<int>("count");
+
+        QTest::newRow("5 patterns") << 5;
+        QTest::newRow("100 patterns") << 100;
+    }
+
+    void matches()
+    {
+        QFETCH(int, count);
+        UrlPatternMatcher matcher(patterns(count));
+
+        // every url is new so the cache doesn't help
+        int n = 0;
+        QBENCHMARK {
+            matcher.matches(QString("https://www.service%1.example.com/api/v1/items/%2")
+                            .arg(count - 1).arg(n++));
+        }
+    }
+
+    void matchesCached_data() { matches_data(); }
+
+    void matchesCached()
+    {
+        QFETCH(int, count);
+        UrlPatternMatcher matcher(patterns(count));
+        QString url = QString("https://www.service%1.example.com/api/v1/items").arg(count - 1);
+
+        bool matched = false;
+        QBENCHMARK {
+            matched = matcher.matches(url);
+        }
+
+        QVERIFY(matched);
+    }
+
+    void create()
+    {
+        QStringList list = patterns(100);
+
+        QBENCHMARK {
+            UrlPatternMatcher matcher(list);
+            Q_UNUSED(matcher);
+        }
+    }
+};
+
+BENCHMARK_MAIN(UrlPatternBenchmark, "urlpattern")
+
+#include "urlpatternbenchmark.moc"
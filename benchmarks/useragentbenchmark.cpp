@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <useragentoverrides.h>
+
+#include "benchmarkrunner.h"
+
+using namespace luna;
+
+static const char *defaultUserAgent =
+    "Mozilla/5.0 (Linux; webOS/3.0.5; U; en-US) AppleWebKit/537.36 (KHTML, like Gecko) Mobile Safari/537.36";
+
+class UserAgentBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVariantMap overrides;
+        for (int n = 0; n < 500; n++)
+            overrides.insert(QString("site%1.example.com").arg(n), QString("Override %1").arg(n));
+        overrides.insert("google.com", QString("Google override"));
+        overrides.insert("plus.google.com", QString("Google plus override"));
+
+        UserAgentOverrides::instance()->load(overrides);
+    }
+
+    void lookup_data()
+    {
+        QTest::addColumn<QString>("url");
+        QTest::addColumn<bool>("overridden");
+
+        QTest::newRow("no override") << QString("https://www.webos-ports.org/wiki/Main_Page") << false;
+        QTest::newRow("domain") << QString("https://mail.google.com/mail/u/0/") << true;
+        QTest::newRow("subdomain") << QString("https://plus.google.com/explore") << true;
+        QTest::newRow("many") << QString("http://site250.example.com/index.html") << true;
+    }
+
+    void lookup()
+    {
+        QFETCH(QString, url);
+        QFETCH(bool, overridden);
+
+        QString defaultAgent(defaultUserAgent);
+        QString userAgent;
+        QBENCHMARK {
+            userAgent = UserAgentOverrides::instance()->lookup(url, defaultAgent);
+        }
+
+        QCOMPARE(userAgent != defaultAgent, overridden);
+    }
+};
+
+BENCHMARK_MAIN(UserAgentBenchmark, "useragent")
+
+#include "useragentbenchmark.moc"
@@ -21,10 +21,11 @@
 #include <QObject>
 #include <QList>
 
+#include <baseextension.h>
+
 namespace luna
 {
 
-class BaseExtension;
 class ApplicationEnvironment;
 
 class ApplicationPlugin
@@ -33,8 +34,25 @@ public:
     virtual QList<BaseExtension*> createExtensions(ApplicationEnvironment *executor) = 0;
 };
 
+/**
+ * Plugins implementing this interface in addition to ApplicationPlugin are
+ * told about the lifecycle of the application and get the lifecycle hooks
+ * of their extensions called. The default implementations do nothing.
+ */
+class LifecycleApplicationPlugin : public ApplicationPlugin
+{
+public:
+    virtual void focusChanged(bool focused) { Q_UNUSED(focused); }
+    virtual void suspended() { }
+    virtual void resumed() { }
+    virtual void memoryPressure(BaseExtension::MemoryPressureLevel level) { Q_UNUSED(level); }
+    // Called before the plugin is unloaded
+    virtual void teardown() { }
+};
+
 } // namespace luna
 
 Q_DECLARE_INTERFACE(luna::ApplicationPlugin, "org.webosports.Application.PluginInterface")
+Q_DECLARE_INTERFACE(luna::LifecycleApplicationPlugin, "org.webosports.Application.LifecyclePluginInterface/4")
 
 #endif // APPLICATIONPLUGIN_H
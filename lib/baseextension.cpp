@@ -15,11 +15,169 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QThreadStorage>
+#include <QVariant>
+#include <qnumeric.h>
+
 #include "baseextension.h"
 #include "applicationenvironment.h"
 
+#define CALLBACK_BUFFER_SIZE 256
+
 using namespace luna;
 
+static QThreadStorage<QString*> callbackBuffers;
+
+/*
+ * Returns the callback buffer of the current thread emptied but with its
+ * capacity kept so it doesn't have to be allocated again. The script is
+ * built as QString right away as that's what it's executed as.
+ */
+static QString& callbackBuffer()
+{
+    if (!callbackBuffers.hasLocalData()) {
+        QString *buffer = new QString;
+        buffer->reserve(CALLBACK_BUFFER_SIZE);
+        callbackBuffers.setLocalData(buffer);
+    }
+
+    QString &buffer = *callbackBuffers.localData();
+    buffer.resize(0);
+    return buffer;
+}
+
+static void appendInteger(QString &buffer, qint64 value)
+{
+    char digits[24];
+    int length = 0;
+    quint64 magnitude = value < 0 ? 0 - static_cast<quint64>(value) : static_cast<quint64>(value);
+
+    do {
+        digits[length++] = '0' + (magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+
+    if (value < 0)
+        buffer.append(QLatin1Char('-'));
+
+    while (length > 0)
+        buffer.append(QLatin1Char(digits[--length]));
+}
+
+static void appendJsonString(QString &buffer, const QString &value)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    buffer.append(QLatin1Char('"'));
+
+    const QChar *data = value.constData();
+    const QChar *end = data + value.length();
+
+    for (; data != end; ++data) {
+        ushort c = data->unicode();
+
+        switch (c) {
+        case '"': buffer.append(QLatin1String("\\\"")); break;
+        case '\\': buffer.append(QLatin1String("\\\\")); break;
+        case '\n': buffer.append(QLatin1String("\\n")); break;
+        case '\r': buffer.append(QLatin1String("\\r")); break;
+        case '\t': buffer.append(QLatin1String("\\t")); break;
+        default:
+            // Escape control characters and the line terminators JavaScript
+            // doesn't accept in string literals
+            if (c < 0x20 || c == 0x2028 || c == 0x2029) {
+                buffer.append(QLatin1String("\\u"));
+                buffer.append(QLatin1Char(hexDigits[(c >> 12) & 0xf]));
+                buffer.append(QLatin1Char(hexDigits[(c >> 8) & 0xf]));
+                buffer.append(QLatin1Char(hexDigits[(c >> 4) & 0xf]));
+                buffer.append(QLatin1Char(hexDigits[c & 0xf]));
+            }
+            else {
+                buffer.append(*data);
+            }
+            break;
+        }
+    }
+
+    buffer.append(QLatin1Char('"'));
+}
+
+static void appendJsonValue(QString &buffer, const QJsonValue &value)
+{
+    switch (value.type()) {
+    case QJsonValue::Null:
+        buffer.append(QLatin1String("null"));
+        break;
+    case QJsonValue::Bool:
+        buffer.append(QLatin1String(value.toBool() ? "true" : "false"));
+        break;
+    case QJsonValue::Double: {
+        double number = value.toDouble();
+        if (qIsNaN(number) || qIsInf(number)) {
+            buffer.append(QLatin1String("null"));
+        }
+        else if (qAbs(number) < 9007199254740992.0 && number == static_cast<qint64>(number)) {
+            appendInteger(buffer, static_cast<qint64>(number));
+        }
+        else {
+            char digits[32];
+            qsnprintf(digits, sizeof(digits), "%.17g", number);
+            buffer.append(QLatin1String(digits));
+        }
+        break;
+    }
+    case QJsonValue::String:
+        appendJsonString(buffer, value.toString());
+        break;
+    // Nested values go through the same escaping; QJsonDocument would leave
+    // U+2028 and U+2029 in strings as they are
+    case QJsonValue::Array: {
+        const QJsonArray array = value.toArray();
+        buffer.append(QLatin1Char('['));
+        for (int n = 0; n < array.size(); n++) {
+            if (n > 0)
+                buffer.append(QLatin1Char(','));
+            // Like JSON.stringify undefined values end up as null in arrays
+            if (array.at(n).isUndefined())
+                buffer.append(QLatin1String("null"));
+            else
+                appendJsonValue(buffer, array.at(n));
+        }
+        buffer.append(QLatin1Char(']'));
+        break;
+    }
+    case QJsonValue::Object: {
+        const QJsonObject object = value.toObject();
+        bool first = true;
+        buffer.append(QLatin1Char('{'));
+        for (QJsonObject::const_iterator iter = object.constBegin(); iter != object.constEnd(); ++iter) {
+            if (iter.value().isUndefined())
+                continue;
+            if (!first)
+                buffer.append(QLatin1Char(','));
+            first = false;
+            appendJsonString(buffer, iter.key());
+            buffer.append(QLatin1Char(':'));
+            appendJsonValue(buffer, iter.value());
+        }
+        buffer.append(QLatin1Char('}'));
+        break;
+    }
+    case QJsonValue::Undefined:
+        break;
+    }
+}
+
+static void appendCallbackStart(QString &buffer, int id, bool keep, bool hasParameters)
+{
+    buffer.append(QLatin1String(keep ? "_webOS.callbackWithoutRemove(" : "_webOS.callback("));
+    appendInteger(buffer, id);
+    if (hasParameters)
+        buffer.append(QLatin1String(", "));
+}
+
 BaseExtension::BaseExtension(const QString &name, ApplicationEnvironment *environment, QObject *parent) :
     QObject(parent),
     mAppEnvironment(environment),
@@ -36,35 +194,93 @@ QString BaseExtension::name() const
     return mName;
 }
 
+/*
+ * The affinity is kept as dynamic property to not change the size of the
+ * class for plugins built against an older version.
+ */
+void BaseExtension::setThreadAffinity(ThreadAffinity affinity)
+{
+    setProperty("threadAffinity", static_cast<int>(affinity));
+}
+
+BaseExtension::ThreadAffinity BaseExtension::threadAffinity() const
+{
+    QVariant affinity = property("threadAffinity");
+    if (!affinity.isValid())
+        return GuiThreadAffinity;
+
+    return static_cast<ThreadAffinity>(affinity.toInt());
+}
+
 QString BaseExtension::handleSynchronousCall(const QString& funcName, const QJsonArray& params)
 {
     return QString("");
 }
 
-void BaseExtension::callback(int id, const QString &parameters)
+void BaseExtension::focusChanged(bool focused)
+{
+    Q_UNUSED(focused);
+}
+
+void BaseExtension::suspended()
 {
-    QString script;
+}
 
-    if (parameters.length() > 0) {
-        script = QString("_webOS.callback(%1, %2);").arg(id).arg(parameters);
-    }
-    else {
-        script = QString("_webOS.callback(%1);").arg(id);
-    }
+void BaseExtension::resumed()
+{
+}
+
+void BaseExtension::memoryPressure(MemoryPressureLevel level)
+{
+    Q_UNUSED(level);
+}
 
-    mAppEnvironment->executeScript(script);
+void BaseExtension::teardown()
+{
+}
+
+void BaseExtension::executeCallback(QString &buffer)
+{
+    buffer.append(QLatin1String(");"));
+    mAppEnvironment->executeScript(buffer);
+}
+
+void BaseExtension::callback(int id, const QString &parameters)
+{
+    QString &buffer = callbackBuffer();
+    appendCallbackStart(buffer, id, false, parameters.length() > 0);
+    buffer.append(parameters);
+    executeCallback(buffer);
 }
 
 void BaseExtension::callbackWithoutRemove(int id, const QString &parameters)
 {
-    QString script;
+    QString &buffer = callbackBuffer();
+    appendCallbackStart(buffer, id, true, parameters.length() > 0);
+    buffer.append(parameters);
+    executeCallback(buffer);
+}
 
-    if (parameters.length() > 0) {
-        script = QString("_webOS.callbackWithoutRemove(%1, %2);").arg(id).arg(parameters);
-    }
-    else {
-        script = QString("_webOS.callbackWithoutRemove(%1);").arg(id);
-    }
+void BaseExtension::callbackWithValue(int id, const QJsonValue &value, CallbackMode mode)
+{
+    QString &buffer = callbackBuffer();
+    appendCallbackStart(buffer, id, mode == KeepCallback, !value.isUndefined());
+    appendJsonValue(buffer, value);
+    executeCallback(buffer);
+}
 
-    mAppEnvironment->executeScript(script);
+void BaseExtension::callbackWithInteger(int id, qint64 value, CallbackMode mode)
+{
+    QString &buffer = callbackBuffer();
+    appendCallbackStart(buffer, id, mode == KeepCallback, true);
+    appendInteger(buffer, value);
+    executeCallback(buffer);
+}
+
+void BaseExtension::callbackWithJson(int id, const QByteArray &json, CallbackMode mode)
+{
+    QString &buffer = callbackBuffer();
+    appendCallbackStart(buffer, id, mode == KeepCallback, json.size() > 0);
+    buffer.append(QString::fromUtf8(json.constData(), json.size()));
+    executeCallback(buffer);
 }
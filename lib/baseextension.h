@@ -20,7 +20,19 @@
 
 #include <QObject>
 #include <QString>
+#include <QByteArray>
 #include <QJsonArray>
+#include <QJsonValue>
+
+/*
+ * Version of the plugin API. Version 2 adds the typed callback methods
+ * (callbackWithValue, callbackWithInteger, callbackWithJson) which are
+ * only available when building against this or a later version. Version 3
+ * adds the thread affinity of extensions. Version 4 adds the lifecycle hooks
+ * which are only called for extensions of plugins implementing
+ * LifecycleApplicationPlugin, older plugins don't have them in their vtable.
+ */
+#define WEBAPP_PLUGIN_API_VERSION 4
 
 namespace luna
 {
@@ -33,23 +45,71 @@ class BaseExtension : public QObject
     Q_PROPERTY(QString name READ name)
 
 public:
+    enum ThreadAffinity {
+        // calls are executed on the GUI thread (default)
+        GuiThreadAffinity,
+        // calls are executed on one of the threads shared by all extensions
+        WorkerPoolAffinity,
+        // the extension gets a thread of its own
+        DedicatedThreadAffinity
+    };
+
+    enum MemoryPressureLevel {
+        // caches which are cheap to rebuild should be dropped
+        LowMemoryPressure = 1,
+        // anything not needed right now should be released
+        MediumMemoryPressure,
+        // the application is about to be killed
+        CriticalMemoryPressure
+    };
+
     explicit BaseExtension(const QString &name, ApplicationEnvironment *environment, QObject *parent = 0);
 
     virtual void initialize();
 
     QString name() const;
 
+    // Has to be set in the constructor. Calls to an extension not running on
+    // the GUI thread are executed in order on its thread and the callbacks
+    // are delivered to the page in the same order.
+    void setThreadAffinity(ThreadAffinity affinity);
+    ThreadAffinity threadAffinity() const;
+
     virtual QString handleSynchronousCall(const QString& funcName, const QJsonArray& params);
 
+    // Lifecycle hooks, called on the thread of the extension. The defaults do
+    // nothing. They have to stay behind all other virtual methods.
+    virtual void focusChanged(bool focused);
+    virtual void suspended();
+    virtual void resumed();
+    virtual void memoryPressure(MemoryPressureLevel level);
+    // Called before the extension is destroyed
+    virtual void teardown();
+
 protected:
+    enum CallbackMode {
+        RemoveCallback,
+        KeepCallback
+    };
+
     void callbackWithoutRemove(int id, const QString &parameters);
     void callback(int id, const QString &parameters);
 
+    // Typed callbacks serialize the result straight into a per thread buffer
+    // which is reused for every callback. An undefined value calls the
+    // callback without a parameter.
+    void callbackWithValue(int id, const QJsonValue &value, CallbackMode mode = RemoveCallback);
+    void callbackWithInteger(int id, qint64 value, CallbackMode mode = RemoveCallback);
+    // json has to be valid UTF-8 encoded JSON; it's passed on unchecked
+    void callbackWithJson(int id, const QByteArray &json, CallbackMode mode = RemoveCallback);
+
 protected:
     ApplicationEnvironment *mAppEnvironment;
 
 private:
     QString mName;
+
+    void executeCallback(QString &buffer);
 };
 
 } // namespace luna
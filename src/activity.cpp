@@ -21,60 +21,80 @@
 #include <glib.h>
 
 #include "activity.h"
+#include "lunaservicethread.h"
+#include "jsonreader.h"
 
 namespace luna
 {
 
 Activity::Activity(const QString& identifier, const QString& appId, const QString& processId) :
-    mHandle(0),
-    mToken(LSMESSAGE_TOKEN_INVALID),
+    mService(0),
     mId(-1),
     mIdentifier(identifier),
     mAppId(appId),
     mProcessId(processId),
     mFocus(false)
 {
+    mReceiverId = LunaServiceThread::instance()->registerReceiver();
+
     setup();
 }
 
 Activity::~Activity()
 {
-    LSError lserror;
-    LSErrorInit(&lserror);
+    LunaServiceThread::instance()->unregisterReceiver(mReceiverId);
 
-    if (mToken != LSMESSAGE_TOKEN_INVALID) {
-        if (!LSCallCancel(mHandle, mToken, &lserror)) {
-            LSErrorPrint(&lserror, stderr);
-            LSErrorFree(&lserror);
+    if (!mService)
+        return;
+
+    // The handle is served by the luna service thread so it's released there
+    // after all calls we scheduled
+    ServiceContext *service = mService;
+    LunaServiceThread::instance()->schedule([service]() {
+        LSError lserror;
+        LSErrorInit(&lserror);
+
+        if (service->token != LSMESSAGE_TOKEN_INVALID) {
+            if (!LSCallCancel(service->handle, service->token, &lserror)) {
+                LSErrorPrint(&lserror, stderr);
+                LSErrorFree(&lserror);
+            }
         }
-    }
 
-    if (mHandle) {
-        if (LSUnregister(mHandle, &lserror)) {
+        if (!LSUnregister(service->handle, &lserror)) {
             LSErrorPrint(&lserror, stderr);
             LSErrorFree(&lserror);
         }
-    }
+
+        delete service;
+    });
 }
 
 void Activity::setup()
 {
     LSError lserror;
     LSErrorInit(&lserror);
+    LSHandle *handle = 0;
 
-    if (!LSRegister(NULL, &mHandle, NULL)) {
+    if (!LSRegister(NULL, &handle, NULL)) {
         LSErrorPrint(&lserror, stderr);
         LSErrorFree(&lserror);
         return;
     }
 
-    GMainLoop *mainloop = g_main_loop_new(g_main_context_default(), TRUE);
-    if (!LSGmainAttach(mHandle, mainloop, &lserror)) {
+    GMainLoop *mainloop = g_main_loop_new(LunaServiceThread::instance()->context(), TRUE);
+    if (!LSGmainAttach(handle, mainloop, &lserror)) {
         LSErrorPrint(&lserror, stderr);
         LSErrorFree(&lserror);
         return;
     }
 
+    mService = new ServiceContext;
+    mService->handle = handle;
+    mService->token = LSMESSAGE_TOKEN_INVALID;
+    mService->receiver = mReceiverId;
+    mService->activity = this;
+
     QJsonObject activity;
     activity.insert("name", mAppId);
     activity.insert("description", mProcessId);
@@ -92,33 +112,61 @@ void Activity::setup()
 
     QJsonDocument payload(request);
 
-    if (!LSCallFromApplication(mHandle, "palm://com.palm.activitymanager/create", payload.toJson().constData(),
-                               mIdentifier.toUtf8().constData(), Activity::activityCallback, this, &mToken, &lserror)) {
-        LSErrorPrint(&lserror, stderr);
-        LSErrorFree(&lserror);
+    call("palm://com.palm.activitymanager/create", payload, true);
+}
+
+/**
+ * Sends a call with our handle from the luna service thread which serves it
+ * without waiting for it. Replies of a subscribing call end up in
+ * handleActivityResponse().
+ */
+void Activity::call(const char *uri, const QJsonDocument &payload, bool subscribe)
+{
+    if (!mService)
         return;
-    }
+
+    ServiceContext *service = mService;
+    QByteArray uriData(uri);
+    QByteArray data = payload.toJson();
+    QByteArray identifier = mIdentifier.toUtf8();
+
+    LunaServiceThread::instance()->schedule([=]() {
+        LSError lserror;
+        LSErrorInit(&lserror);
+
+        if (!LSCallFromApplication(service->handle, uriData.constData(), data.constData(),
+                                   identifier.constData(), subscribe ? Activity::activityCallback : 0,
+                                   subscribe ? service : 0, subscribe ? &service->token : 0, &lserror)) {
+            LSErrorPrint(&lserror, stderr);
+            LSErrorFree(&lserror);
+        }
+    });
 }
 
 bool Activity::activityCallback(LSHandle *handle, LSMessage *message, void *user_data)
 {
-    Activity *activity = static_cast<Activity*>(user_data);
-    activity->handleActivityResponse(message);
+    handleActivityResponse(static_cast<ServiceContext*>(user_data), message);
     return true;
 }
 
-void Activity::handleActivityResponse(LSMessage *message)
+void Activity::handleActivityResponse(ServiceContext *service, LSMessage *message)
 {
-    QJsonDocument payload = QJsonDocument::fromJson(QByteArray(LSMessageGetPayload(message)));
-    if (!payload.isObject())
+    // Called on the luna service thread so decode the response here and only
+    // hand the result over to the GUI thread
+    JsonReader response(QByteArray(LSMessageGetPayload(message)));
+    if (!response.isObject())
         return;
 
-    QJsonObject response = payload.object();
-
-    if (!response.value("returnValue").toBool(false))
+    if (!response.boolValue("returnValue", false))
         return;
 
-    mId = response.value("activityId").toInt(-1);
+    int id = response.intValue("activityId", -1);
+    Activity *activity = service->activity;
+
+    // dropped when the activity is gone meanwhile
+    LunaServiceThread::instance()->post(service->receiver, [=]() {
+        activity->mId = id;
+    });
 }
 
 int Activity::id() const
@@ -131,20 +179,12 @@ void Activity::focus()
     if (mFocus || mId == LSMESSAGE_TOKEN_INVALID)
         return;
 
-    LSError lserror;
-    LSErrorInit(&lserror);
-
     QJsonObject request;
     request.insert("activityId", mId);
 
     QJsonDocument payload(request);
 
-    if (!LSCallFromApplication(mHandle, "palm://com.palm.activitymanager/focus", payload.toJson().constData(),
-                               mIdentifier.toUtf8().constData(), 0, 0, 0, &lserror)) {
-        LSErrorPrint(&lserror, stderr);
-        LSErrorFree(&lserror);
-        return;
-    }
+    call("palm://com.palm.activitymanager/focus", payload, false);
 
     mFocus = true;
 }
@@ -154,20 +194,12 @@ void Activity::unfocus()
     if (!mFocus || mId == LSMESSAGE_TOKEN_INVALID)
         return;
 
-    LSError lserror;
-    LSErrorInit(&lserror);
-
     QJsonObject request;
     request.insert("activityId", mId);
 
     QJsonDocument payload(request);
 
-    if (!LSCallFromApplication(mHandle, "palm://com.palm.activitymanager/unfocus", payload.toJson().constData(),
-                               mIdentifier.toUtf8().constData(), 0, 0, 0, &lserror)) {
-        LSErrorPrint(&lserror, stderr);
-        LSErrorFree(&lserror);
-        return;
-    }
+    call("palm://com.palm.activitymanager/unfocus", payload, false);
 
     mFocus = false;
 }
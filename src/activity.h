@@ -21,6 +21,8 @@
 #include <QString>
 #include <luna-service2/lunaservice.h>
 
+class QJsonDocument;
+
 namespace luna
 {
 
@@ -38,16 +40,27 @@ public:
     static bool activityCallback(LSHandle *handle, LSMessage *message, void *user_data);
 
 private:
-    LSHandle *mHandle;
-    LSMessageToken mToken;
+    // What the service thread needs for our calls. It's released there once
+    // the handle is gone so replies never see a deleted activity.
+    struct ServiceContext
+    {
+        LSHandle *handle;
+        LSMessageToken token;
+        int receiver;
+        Activity *activity;
+    };
+
+    ServiceContext *mService;
     int mId;
     QString mAppId;
     QString mProcessId;
     QString mIdentifier;
     bool mFocus;
+    int mReceiverId;
 
     void setup();
-    void handleActivityResponse(LSMessage *message);
+    void call(const char *uri, const QJsonDocument &payload, bool subscribe);
+    static void handleActivityResponse(ServiceContext *service, LSMessage *message);
 };
 
 } // namespace
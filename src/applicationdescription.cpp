@@ -15,19 +15,18 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
 #include <QFile>
 #include <QDebug>
 
 #include "applicationdescription.h"
+#include "jsonreader.h"
 
 namespace luna
 {
 
 ApplicationDescription::ApplicationDescription() :
-    mHeadless(false)
+    mHeadless(false),
+    mStreamServiceResponses(false)
 {
 }
 
@@ -43,7 +42,8 @@ ApplicationDescription::ApplicationDescription(const ApplicationDescription& oth
     mInternetConnectivityRequired(other.internetConnectivityRequired()),
     mUrlsAllowed(other.urlsAllowed()),
     mUserAgent(other.userAgent()),
-    mLoadingAnimationDisabled(other.loadingAnimationDisabled())
+    mLoadingAnimationDisabled(other.loadingAnimationDisabled()),
+    mStreamServiceResponses(other.streamServiceResponses())
 {
 }
 
@@ -53,7 +53,8 @@ ApplicationDescription::ApplicationDescription(const QString &data, const QStrin
     mInternetConnectivityRequired(false),
     mApplicationBasePath(applicationBasePath),
     mUserAgent(""),
-    mLoadingAnimationDisabled(false)
+    mLoadingAnimationDisabled(false),
+    mStreamServiceResponses(false)
 {
     initializeFromData(data);
 }
@@ -64,29 +65,27 @@ ApplicationDescription::~ApplicationDescription()
 
 void ApplicationDescription::initializeFromData(const QString &data)
 {
-    QJsonDocument document = QJsonDocument::fromJson(data.toUtf8());
+    JsonReader rootObject(data.toUtf8());
 
-    if (!document.isObject()) {
+    if (!rootObject.isObject()) {
         qWarning() << "Failed to parse application description";
         return;
     }
 
-    QJsonObject rootObject = document.object();
-
-    if (rootObject.contains("id") && rootObject.value("id").isString())
-        mId = rootObject.value("id").toString();
+    if (rootObject.isString("id"))
+        mId = rootObject.stringValue("id");
 
-    if (rootObject.contains("main") && rootObject.value("main").isString())
-        mEntryPoint = locateEntryPoint(rootObject.value("main").toString());
+    if (rootObject.isString("main"))
+        mEntryPoint = locateEntryPoint(rootObject.stringValue("main"));
 
-    if (rootObject.contains("noWindow") && rootObject.value("noWindow").isBool())
-        mHeadless = rootObject.value("noWindow").toBool();
+    if (rootObject.isBool("noWindow"))
+        mHeadless = rootObject.boolValue("noWindow");
 
-    if (rootObject.contains("title") && rootObject.value("title").isString())
-        mTitle = rootObject.value("title").toString();
+    if (rootObject.isString("title"))
+        mTitle = rootObject.stringValue("title");
 
-    if (rootObject.contains("icon") && rootObject.value("icon").isString()) {
-        QString iconPath = rootObject.value("icon").toString();
+    if (rootObject.isString("icon")) {
+        QString iconPath = rootObject.stringValue("icon");
 
         // we're only allow locally stored icons so we must prefix them with file:// to
         // store it in a QUrl object
@@ -98,33 +97,29 @@ void ApplicationDescription::initializeFromData(const QString &data)
         mIcon = iconPath;
     }
 
-    if (rootObject.contains("flickable") && rootObject.value("flickable").isBool())
-        mFlickable = rootObject.value("flickable").toBool();
+    if (rootObject.isBool("flickable"))
+        mFlickable = rootObject.boolValue("flickable");
 
-    if (rootObject.contains("internetConnectivityRequired") && rootObject.value("internetConnectivityRequired").isBool())
-        mInternetConnectivityRequired = rootObject.value("internetConnectivityRequired").toBool();
+    if (rootObject.isBool("internetConnectivityRequired"))
+        mInternetConnectivityRequired = rootObject.boolValue("internetConnectivityRequired");
 
     if (mIcon.isEmpty() || !mIcon.isLocalFile() || !QFile::exists(mIcon.toLocalFile()))
         mIcon = QUrl("qrc:///qml/images/default-app-icon.png");
 
-    if (rootObject.contains("urlsAllowed") && rootObject.value("urlsAllowed").isArray()) {
-        QJsonArray urlsAllowed = rootObject.value("urlsAllowed").toArray();
-        for (int n = 0; n < urlsAllowed.size(); n++) {
-            if (!urlsAllowed[n].isString())
-                continue;
+    if (rootObject.isArray("urlsAllowed"))
+        mUrlsAllowed = rootObject.stringListValue("urlsAllowed");
 
-            mUrlsAllowed.append(urlsAllowed[n].toString());
-        }
-    }
+    if (rootObject.isString("plugin"))
+        mPluginName = rootObject.stringValue("plugin");
 
-    if (rootObject.contains("plugin") && rootObject.value("plugin").isString())
-        mPluginName = rootObject.value("plugin").toString();
+    if (rootObject.isString("userAgent"))
+        mUserAgent = rootObject.stringValue("userAgent");
 
-    if (rootObject.contains("userAgent") && rootObject.value("userAgent").isString())
-        mUserAgent = rootObject.value("userAgent").toString();
+    if (rootObject.isBool("loadingAnimationDisabled"))
+        mLoadingAnimationDisabled = rootObject.boolValue("loadingAnimationDisabled");
 
-    if (rootObject.contains("loadingAnimationDisabled") && rootObject.value("loadingAnimationDisabled").isBool())
-        mLoadingAnimationDisabled = rootObject.value("loadingAnimationDisabled").toBool();
+    if (rootObject.isBool("streamServiceResponses"))
+        mStreamServiceResponses = rootObject.boolValue("streamServiceResponses");
 }
 
 QUrl ApplicationDescription::locateEntryPoint(const QString &entryPoint)
@@ -212,4 +207,9 @@ bool ApplicationDescription::loadingAnimationDisabled() const
     return mLoadingAnimationDisabled;
 }
 
+bool ApplicationDescription::streamServiceResponses() const
+{
+    return mStreamServiceResponses;
+}
+
 }
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QDateTime>
+#include <QMutexLocker>
+
+#include "bridgestatistics.h"
+
+namespace luna
+{
+
+BridgeStatistics::FunctionStatistics::FunctionStatistics() :
+    syncCalls(0),
+    asyncCalls(0),
+    responses(0),
+    timedResponses(0),
+    syncTime(0),
+    asyncTime(0),
+    maxTime(0),
+    responseLatency(0),
+    bytesIn(0),
+    bytesOut(0)
+{
+}
+
+BridgeStatistics::ApplicationStatistics::ApplicationStatistics() :
+    scripts(0),
+    scriptBytes(0)
+{
+}
+
+BridgeStatistics* BridgeStatistics::instance()
+{
+    static BridgeStatistics statistics;
+    return &statistics;
+}
+
+BridgeStatistics::BridgeStatistics() :
+    mSince(QDateTime::currentMSecsSinceEpoch())
+{
+}
+
+/**
+ * Records a call from the page. The duration is the time the extension
+ * needed to handle it, in microseconds.
+ */
+void BridgeStatistics::recordCall(const QString &appId, const QString &extension, const QString &function,
+                                  CallType type, qint64 duration, int bytesIn, int bytesOut)
+{
+    QMutexLocker locker(&mMutex);
+
+    FunctionStatistics &statistics = mApplications[appId].extensions[extension][function];
+
+    if (type == SynchronousCall) {
+        statistics.syncCalls++;
+        statistics.syncTime += duration;
+    }
+    else {
+        statistics.asyncCalls++;
+        statistics.asyncTime += duration;
+    }
+
+    if (duration > statistics.maxTime)
+        statistics.maxTime = duration;
+
+    statistics.bytesIn += bytesIn;
+    statistics.bytesOut += bytesOut;
+}
+
+/**
+ * Records a response to an earlier asynchronous call, like the reply of a
+ * service called through PalmServiceBridge. The latency is -1 for responses
+ * which don't answer a call directly, like later updates of a subscription.
+ */
+void BridgeStatistics::recordResponse(const QString &appId, const QString &extension, const QString &function,
+                                      qint64 latency, int bytesOut)
+{
+    QMutexLocker locker(&mMutex);
+
+    FunctionStatistics &statistics = mApplications[appId].extensions[extension][function];
+    statistics.responses++;
+    if (latency >= 0) {
+        statistics.timedResponses++;
+        statistics.responseLatency += latency;
+    }
+    statistics.bytesOut += bytesOut;
+}
+
+void BridgeStatistics::recordScript(const QString &appId, int bytes)
+{
+    QMutexLocker locker(&mMutex);
+
+    ApplicationStatistics &statistics = mApplications[appId];
+    statistics.scripts++;
+    statistics.scriptBytes += bytes;
+}
+
+QJsonObject BridgeStatistics::toJson() const
+{
+    QMutexLocker locker(&mMutex);
+
+    QJsonObject applications;
+
+    QHash<QString, ApplicationStatistics>::const_iterator app;
+    for (app = mApplications.constBegin(); app != mApplications.constEnd(); ++app) {
+        QJsonObject extensions;
+
+        QHash<QString, QHash<QString, FunctionStatistics> >::const_iterator extension;
+        for (extension = app->extensions.constBegin(); extension != app->extensions.constEnd(); ++extension) {
+            QJsonObject functions;
+
+            QHash<QString, FunctionStatistics>::const_iterator function;
+            for (function = extension->constBegin(); function != extension->constEnd(); ++function) {
+                QJsonObject entry;
+                entry.insert("syncCalls", (double) function->syncCalls);
+                entry.insert("asyncCalls", (double) function->asyncCalls);
+                entry.insert("syncTimeUs", (double) function->syncTime);
+                entry.insert("asyncTimeUs", (double) function->asyncTime);
+                entry.insert("maxTimeUs", (double) function->maxTime);
+                entry.insert("bytesIn", (double) function->bytesIn);
+                entry.insert("bytesOut", (double) function->bytesOut);
+                if (function->responses > 0)
+                    entry.insert("responses", (double) function->responses);
+                if (function->timedResponses > 0)
+                    entry.insert("averageResponseLatencyUs",
+                                 (double) (function->responseLatency / (qint64) function->timedResponses));
+                functions.insert(function.key(), entry);
+            }
+
+            extensions.insert(extension.key(), functions);
+        }
+
+        QJsonObject scripts;
+        scripts.insert("count", (double) app->scripts);
+        scripts.insert("bytes", (double) app->scriptBytes);
+
+        QJsonObject entry;
+        entry.insert("extensions", extensions);
+        entry.insert("executedScripts", scripts);
+        applications.insert(app.key(), entry);
+    }
+
+    QJsonObject result;
+    result.insert("since", (double) mSince);
+    result.insert("applications", applications);
+    return result;
+}
+
+void BridgeStatistics::reset()
+{
+    QMutexLocker locker(&mMutex);
+
+    mApplications.clear();
+    mSince = QDateTime::currentMSecsSinceEpoch();
+}
+
+} // namespace luna
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef BRIDGESTATISTICS_H
+#define BRIDGESTATISTICS_H
+
+#include <QHash>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+
+namespace luna
+{
+
+/**
+ * Counts and times the calls going over the bridge between the page and the
+ * launcher per application, extension and function. Sizes are the length of
+ * the messages as they pass the bridge, in characters. Calls are recorded
+ * from whatever thread executes them.
+ */
+class BridgeStatistics
+{
+public:
+    enum CallType {
+        SynchronousCall,
+        AsynchronousCall
+    };
+
+    static BridgeStatistics* instance();
+
+    void recordCall(const QString &appId, const QString &extension, const QString &function,
+                    CallType type, qint64 duration, int bytesIn, int bytesOut);
+    void recordResponse(const QString &appId, const QString &extension, const QString &function,
+                        qint64 latency, int bytesOut);
+    void recordScript(const QString &appId, int bytes);
+
+    QJsonObject toJson() const;
+    void reset();
+
+private:
+    struct FunctionStatistics
+    {
+        FunctionStatistics();
+
+        quint64 syncCalls;
+        quint64 asyncCalls;
+        quint64 responses;
+        // responses answering a call, only those have a latency
+        quint64 timedResponses;
+        // all times in microseconds
+        qint64 syncTime;
+        qint64 asyncTime;
+        qint64 maxTime;
+        qint64 responseLatency;
+        quint64 bytesIn;
+        quint64 bytesOut;
+    };
+
+    struct ApplicationStatistics
+    {
+        ApplicationStatistics();
+
+        QHash<QString, QHash<QString, FunctionStatistics> > extensions;
+        quint64 scripts;
+        quint64 scriptBytes;
+    };
+
+    BridgeStatistics();
+
+    mutable QMutex mMutex;
+    QHash<QString, ApplicationStatistics> mApplications;
+    qint64 mSince;
+};
+
+} // namespace luna
+
+#endif // BRIDGESTATISTICS_H
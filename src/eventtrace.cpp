@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QDebug>
+#include <QDir>
+
+#include <atomic>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "eventtrace.h"
+
+// Has to be a power of two; 8192 events take 384 kB
+#define TRACE_CAPACITY 8192
+
+namespace luna
+{
+
+static TraceEvent traceEvents[TRACE_CAPACITY];
+static std::atomic<uint64_t> traceHead(0);
+
+static char traceDumpPath[PATH_MAX];
+static char traceCrashPath[PATH_MAX];
+
+static inline uint64_t clockNanoseconds(clockid_t clock)
+{
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static inline uint16_t currentThread()
+{
+    static thread_local uint16_t thread = 0;
+    if (thread == 0)
+        thread = (uint16_t) syscall(SYS_gettid);
+    return thread;
+}
+
+TraceEvent* EventTrace::reserve(TraceEventType type, quint32 value, quint32 extra, uint64_t &sequence)
+{
+    uint64_t position = traceHead.fetch_add(1, std::memory_order_relaxed);
+    TraceEvent *event = &traceEvents[position & (TRACE_CAPACITY - 1)];
+
+    // Mark the slot as being written so a dump in between skips it
+    __atomic_store_n(&event->sequence, 0, __ATOMIC_RELAXED);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    event->timestamp = clockNanoseconds(CLOCK_MONOTONIC);
+    event->type = type;
+    event->thread = currentThread();
+    event->value = value;
+    event->extra = extra;
+    event->tag[0] = '\0';
+
+    sequence = position + 1;
+    return event;
+}
+
+void EventTrace::commit(TraceEvent *event, uint64_t sequence)
+{
+    __atomic_store_n(&event->sequence, sequence, __ATOMIC_RELEASE);
+}
+
+void EventTrace::record(TraceEventType type, quint32 value, quint32 extra)
+{
+    uint64_t sequence;
+    commit(reserve(type, value, extra, sequence), sequence);
+}
+
+void EventTrace::record(TraceEventType type, quint32 value, quint32 extra, const QString &tag)
+{
+    uint64_t sequence;
+    TraceEvent *event = reserve(type, value, extra, sequence);
+
+    // Copy without converting the whole string, it's only a hint
+    int length = qMin(tag.size(), TRACE_TAG_SIZE - 1);
+    const QChar *data = tag.constData();
+    for (int n = 0; n < length; n++)
+        event->tag[n] = data[n].toLatin1();
+    event->tag[length] = '\0';
+
+    commit(event, sequence);
+}
+
+void EventTrace::record(TraceEventType type, quint32 value, quint32 extra, const char *tag)
+{
+    uint64_t sequence;
+    TraceEvent *event = reserve(type, value, extra, sequence);
+
+    if (tag) {
+        strncpy(event->tag, tag, TRACE_TAG_SIZE - 1);
+        event->tag[TRACE_TAG_SIZE - 1] = '\0';
+    }
+
+    commit(event, sequence);
+}
+
+bool EventTrace::dump(const char *path)
+{
+    if (path[0] == '\0')
+        return false;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+
+    TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_FORMAT_VERSION;
+    header.eventSize = sizeof(TraceEvent);
+    header.capacity = TRACE_CAPACITY;
+    header.pid = getpid();
+    header.recorded = traceHead.load(std::memory_order_relaxed);
+    header.monotonicTime = clockNanoseconds(CLOCK_MONOTONIC);
+    header.realTime = clockNanoseconds(CLOCK_REALTIME);
+
+    bool written = write(fd, &header, sizeof(header)) == sizeof(header) &&
+                   write(fd, traceEvents, sizeof(traceEvents)) == sizeof(traceEvents);
+
+    close(fd);
+    return written;
+}
+
+void EventTrace::handleSignal(int signal)
+{
+    if (signal == SIGUSR1) {
+        dump(traceDumpPath);
+        return;
+    }
+
+    dump(traceCrashPath);
+
+    // Let the default action take place to get the usual core dump
+    ::signal(signal, SIG_DFL);
+    raise(signal);
+}
+
+void EventTrace::installDumpHandlers(const QString &directory, const QString &name)
+{
+    QDir().mkpath(directory);
+
+    QByteArray dumpPath = QString("%1/%2.trace").arg(directory).arg(name).toLocal8Bit();
+    QByteArray crashPath = QString("%1/%2-crash.trace").arg(directory).arg(name).toLocal8Bit();
+
+    if (dumpPath.size() >= PATH_MAX || crashPath.size() >= PATH_MAX) {
+        qWarning() << "Path for event trace dumps too long:" << directory;
+        return;
+    }
+
+    strcpy(traceDumpPath, dumpPath.constData());
+    strcpy(traceCrashPath, crashPath.constData());
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = EventTrace::handleSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+
+    int crashSignals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+    for (unsigned int n = 0; n < sizeof(crashSignals) / sizeof(crashSignals[0]); n++)
+        sigaction(crashSignals[n], &action, NULL);
+}
+
+} // namespace luna
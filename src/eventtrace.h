@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef EVENTTRACE_H
+#define EVENTTRACE_H
+
+#include <QString>
+
+#include "eventtraceformat.h"
+
+namespace luna
+{
+
+/**
+ * Always on, per process trace of compact binary events in a fixed size
+ * ring buffer. Recording an event takes one atomic increment and no lock
+ * so it can be done from any thread in hot paths. The buffer is written to
+ * a file on SIGUSR1 and when the process crashes; use webapp-trace-decode
+ * to read it.
+ */
+class EventTrace
+{
+public:
+    static void record(TraceEventType type, quint32 value = 0, quint32 extra = 0);
+    static void record(TraceEventType type, quint32 value, quint32 extra, const QString &tag);
+    static void record(TraceEventType type, quint32 value, quint32 extra, const char *tag);
+
+    // Sets up dumping to <directory>/<name>.trace on SIGUSR1 and to
+    // <directory>/<name>-crash.trace on a crash
+    static void installDumpHandlers(const QString &directory, const QString &name);
+
+    // Only uses async signal safe functions
+    static bool dump(const char *path);
+
+private:
+    static TraceEvent* reserve(TraceEventType type, quint32 value, quint32 extra, uint64_t &sequence);
+    static void commit(TraceEvent *event, uint64_t sequence);
+    static void handleSignal(int signal);
+};
+
+} // namespace luna
+
+#endif // EVENTTRACE_H
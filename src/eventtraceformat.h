@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef EVENTTRACEFORMAT_H
+#define EVENTTRACEFORMAT_H
+
+#include <stdint.h>
+
+/*
+ * On disk format of event trace dumps. It's shared with the decoder tool so
+ * it must not depend on Qt. A dump is a TraceHeader followed by the raw ring
+ * buffer of `capacity` TraceEvent records; empty slots have a sequence of 0.
+ */
+
+#define TRACE_MAGIC "WALTRACE"
+#define TRACE_FORMAT_VERSION 1
+#define TRACE_TAG_SIZE 20
+
+namespace luna
+{
+
+enum TraceEventType {
+    TraceBridgeSyncCall = 1,    // value: duration in us, extra: response size, tag: function
+    TraceBridgeAsyncCall,       // value: message size, tag: function
+    TraceScriptInjection,       // value: script size, tag: start of the script
+    TraceLunaReply,             // value: payload size, extra: token, tag: sender
+    TraceFocusChange,           // value: 1 if focused
+    TraceLoadState,             // value: QQuickWebView::LoadStatus, tag: host
+    TracePropertyRead,          // tag: property name
+    TraceResourceRead,          // value: size, tag: file name
+    TraceEventTypeCount
+};
+
+struct TraceHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t eventSize;
+    uint32_t capacity;
+    uint32_t pid;
+    // number of events recorded so far, including overwritten ones
+    uint64_t recorded;
+    // CLOCK_MONOTONIC and CLOCK_REALTIME in ns at the time of the dump
+    uint64_t monotonicTime;
+    uint64_t realTime;
+};
+
+struct TraceEvent
+{
+    // position in the stream of events plus one, written last
+    uint64_t sequence;
+    // CLOCK_MONOTONIC in ns
+    uint64_t timestamp;
+    uint16_t type;
+    uint16_t thread;
+    uint32_t value;
+    uint32_t extra;
+    char tag[TRACE_TAG_SIZE];
+};
+
+inline const char* traceEventTypeName(unsigned int type)
+{
+    static const char *names[] = {
+        "unknown",
+        "bridge-sync-call",
+        "bridge-async-call",
+        "script-injection",
+        "luna-reply",
+        "focus-change",
+        "load-state",
+        "property-read",
+        "resource-read"
+    };
+
+    if (type >= TraceEventTypeCount)
+        return names[0];
+
+    return names[type];
+}
+
+} // namespace luna
+
+#endif // EVENTTRACEFORMAT_H
@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QDebug>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QMetaMethod>
+#include <QSemaphore>
+#include <QThread>
+
+#include <baseextension.h>
+
+#include "extensiondispatcher.h"
+#include "bridgestatistics.h"
+
+#define SHARED_EXTENSION_THREADS 2
+
+namespace luna
+{
+
+class ExtensionTaskEvent : public QEvent
+{
+public:
+    ExtensionTaskEvent(const std::function<void()> &task) :
+        QEvent(QEvent::User),
+        mTask(task)
+    {
+    }
+
+    std::function<void()> mTask;
+};
+
+/**
+ * Lives on the thread of an extension and runs the tasks posted to it.
+ */
+class ExtensionTaskInvoker : public QObject
+{
+public:
+    bool event(QEvent *event)
+    {
+        if (event->type() != QEvent::User)
+            return QObject::event(event);
+
+        static_cast<ExtensionTaskEvent*>(event)->mTask();
+        return true;
+    }
+};
+
+/**
+ * Threads shared by all extensions with worker pool affinity. An extension
+ * stays on the thread it was assigned to so its calls keep their order.
+ */
+class SharedExtensionThreads
+{
+public:
+    static SharedExtensionThreads* instance()
+    {
+        static SharedExtensionThreads* instance = 0;
+
+        if (!instance)
+            instance = new SharedExtensionThreads();
+
+        return instance;
+    }
+
+    QThread* acquire()
+    {
+        QMutexLocker locker(&mMutex);
+
+        if (mThreads.count() < SHARED_EXTENSION_THREADS) {
+            QThread *thread = new QThread;
+            thread->setObjectName("ExtensionWorker");
+            thread->start();
+            mThreads.append(thread);
+            mUsers.append(0);
+        }
+
+        int leastUsed = 0;
+        for (int n = 1; n < mThreads.count(); n++) {
+            if (mUsers[n] < mUsers[leastUsed])
+                leastUsed = n;
+        }
+
+        mUsers[leastUsed]++;
+        return mThreads[leastUsed];
+    }
+
+    void release(QThread *thread)
+    {
+        QMutexLocker locker(&mMutex);
+
+        int index = mThreads.indexOf(thread);
+        if (index >= 0)
+            mUsers[index]--;
+    }
+
+private:
+    QMutex mMutex;
+    QList<QThread*> mThreads;
+    QList<int> mUsers;
+};
+
+ExtensionDispatcher::ExtensionDispatcher(BaseExtension *extension, QObject *parent) :
+    QObject(parent),
+    mExtension(extension),
+    mThread(0),
+    mDedicatedThread(extension->threadAffinity() == BaseExtension::DedicatedThreadAffinity),
+    mInvoker(new ExtensionTaskInvoker),
+    mQueueDepth(0),
+    mPeakQueueDepth(0),
+    mCalls(0),
+    mTotalQueueLatency(0),
+    mMaxQueueLatency(0),
+    mTotalExecutionTime(0)
+{
+    if (mDedicatedThread) {
+        mThread = new QThread;
+        mThread->setObjectName(QString("Extension%1").arg(extension->name()));
+        mThread->start();
+    }
+    else {
+        mThread = SharedExtensionThreads::instance()->acquire();
+    }
+
+    mExtension->moveToThread(mThread);
+    mInvoker->moveToThread(mThread);
+}
+
+ExtensionDispatcher::~ExtensionDispatcher()
+{
+    // Objects can only be pushed away from the thread they live in so hand
+    // the extension back from its thread
+    QThread *guiThread = QCoreApplication::instance()->thread();
+    runBlocking([=]() {
+        mExtension->moveToThread(guiThread);
+        mInvoker->moveToThread(guiThread);
+    });
+
+    delete mInvoker;
+
+    if (mDedicatedThread) {
+        mThread->quit();
+        mThread->wait();
+        delete mThread;
+    }
+    else {
+        SharedExtensionThreads::instance()->release(mThread);
+    }
+}
+
+/**
+ * Queues the task to the extension's thread. When done is given it's
+ * released after the task and its accounting finished.
+ */
+void ExtensionDispatcher::enqueue(const std::function<void()> &task, QSemaphore *done)
+{
+    int depth = mQueueDepth.fetchAndAddOrdered(1) + 1;
+
+    {
+        QMutexLocker locker(&mStatisticsMutex);
+        if (depth > mPeakQueueDepth)
+            mPeakQueueDepth = depth;
+    }
+
+    QElapsedTimer queued;
+    queued.start();
+
+    QCoreApplication::postEvent(mInvoker, new ExtensionTaskEvent([=]() {
+        qint64 queueLatency = queued.nsecsElapsed() / 1000;
+
+        QElapsedTimer execution;
+        execution.start();
+
+        task();
+
+        mQueueDepth.fetchAndAddOrdered(-1);
+        recordCall(queueLatency, execution.nsecsElapsed() / 1000);
+
+        if (done)
+            done->release();
+    }));
+}
+
+void ExtensionDispatcher::runBlocking(const std::function<void()> &task)
+{
+    QSemaphore done;
+    enqueue(task, &done);
+    done.acquire();
+}
+
+void ExtensionDispatcher::recordCall(qint64 queueLatency, qint64 executionTime)
+{
+    QMutexLocker locker(&mStatisticsMutex);
+
+    mCalls++;
+    mTotalQueueLatency += queueLatency;
+    mTotalExecutionTime += executionTime;
+    if (queueLatency > mMaxQueueLatency)
+        mMaxQueueLatency = queueLatency;
+}
+
+void ExtensionDispatcher::initialize()
+{
+    enqueue([=]() {
+        mExtension->initialize();
+    });
+}
+
+void ExtensionDispatcher::call(const QString &funcName, const QVariantList &params,
+                               const QString &appId, int bytesIn)
+{
+    enqueue([=]() {
+        QElapsedTimer timer;
+        timer.start();
+
+        invokeMethod(mExtension, funcName, params);
+
+        BridgeStatistics::instance()->recordCall(appId, mExtension->name(), funcName,
+                                                 BridgeStatistics::AsynchronousCall,
+                                                 timer.nsecsElapsed() / 1000, bytesIn, 0);
+    });
+}
+
+/**
+ * Synchronous calls block the GUI thread until the extension's thread
+ * handled them; the page is blocked on them anyway.
+ */
+QString ExtensionDispatcher::callSynchronous(const QString &funcName, const QJsonArray &params)
+{
+    QString response;
+
+    runBlocking([&]() {
+        response = mExtension->handleSynchronousCall(funcName, params);
+    });
+
+    return response;
+}
+
+/**
+ * Runs a lifecycle hook of the extension on its thread, in order with the
+ * calls queued before.
+ */
+void ExtensionDispatcher::runHook(const std::function<void(BaseExtension*)> &hook)
+{
+    BaseExtension *extension = mExtension;
+    enqueue([=]() {
+        hook(extension);
+    });
+}
+
+/**
+ * Invokes the slot or invokable method with the given name the same way QML
+ * would do it: parameters the method doesn't take are ignored, the overload
+ * taking the most of them wins and parameters which can't be converted
+ * (null or undefined ones for example) are passed as default values.
+ */
+void ExtensionDispatcher::invokeMethod(BaseExtension *extension, const QString &funcName, QVariantList params)
+{
+    const QMetaObject *metaObject = extension->metaObject();
+    QByteArray name = funcName.toUtf8();
+    QMetaMethod method;
+
+    for (int n = 0; n < metaObject->methodCount(); n++) {
+        QMetaMethod candidate = metaObject->method(n);
+
+        if (candidate.access() != QMetaMethod::Public || candidate.methodType() == QMetaMethod::Signal ||
+            candidate.name() != name || candidate.parameterCount() > params.count())
+            continue;
+
+        if (!method.isValid() || candidate.parameterCount() > method.parameterCount())
+            method = candidate;
+    }
+
+    if (!method.isValid()) {
+        qWarning() << "Extension" << extension->name() << "has no method" << funcName
+                   << "taking up to" << params.count() << "parameters";
+        return;
+    }
+
+    if (method.parameterCount() > 10) {
+        qWarning() << "Too many parameters for" << extension->name() << funcName;
+        return;
+    }
+
+    QList<QByteArray> typeNames = method.parameterTypes();
+    QGenericArgument arguments[10];
+
+    for (int i = 0; i < method.parameterCount(); i++) {
+        int type = method.parameterType(i);
+
+        if (type != QMetaType::QVariant && !params[i].convert(type))
+            params[i] = QVariant(type, (const void*) 0);
+
+        const void *data = (type == QMetaType::QVariant) ? &params[i] : params[i].constData();
+        arguments[i] = QGenericArgument(typeNames[i].constData(), data);
+    }
+
+    method.invoke(extension, Qt::DirectConnection,
+                  arguments[0], arguments[1], arguments[2], arguments[3], arguments[4],
+                  arguments[5], arguments[6], arguments[7], arguments[8], arguments[9]);
+}
+
+QVariantMap ExtensionDispatcher::statistics() const
+{
+    QMutexLocker locker(&mStatisticsMutex);
+
+    QVariantMap statistics;
+    statistics.insert("thread", mDedicatedThread ? "dedicated" : "shared");
+    statistics.insert("calls", mCalls);
+    statistics.insert("queueDepth", mQueueDepth.load());
+    statistics.insert("peakQueueDepth", mPeakQueueDepth);
+    statistics.insert("averageQueueLatencyUs", mCalls > 0 ? mTotalQueueLatency / (qint64) mCalls : 0);
+    statistics.insert("maxQueueLatencyUs", mMaxQueueLatency);
+    statistics.insert("averageExecutionTimeUs", mCalls > 0 ? mTotalExecutionTime / (qint64) mCalls : 0);
+
+    return statistics;
+}
+
+} // namespace luna
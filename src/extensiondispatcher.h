@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef EXTENSIONDISPATCHER_H
+#define EXTENSIONDISPATCHER_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QJsonArray>
+#include <QMutex>
+#include <QVariantList>
+#include <QVariantMap>
+
+#include <functional>
+
+class QSemaphore;
+class QThread;
+
+namespace luna
+{
+
+class BaseExtension;
+
+/**
+ * Executes the calls of an extension which doesn't want to run on the GUI
+ * thread. The extension is moved to a thread shared with other extensions
+ * or a dedicated one depending on its affinity; calls are queued to that
+ * thread in order. Queue depth and latency are recorded per extension.
+ */
+class ExtensionDispatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ExtensionDispatcher(BaseExtension *extension, QObject *parent = 0);
+    ~ExtensionDispatcher();
+
+    void initialize();
+    void call(const QString &funcName, const QVariantList &params, const QString &appId, int bytesIn);
+    QString callSynchronous(const QString &funcName, const QJsonArray &params);
+    void runHook(const std::function<void(BaseExtension*)> &hook);
+
+    QVariantMap statistics() const;
+
+    static void invokeMethod(BaseExtension *extension, const QString &funcName, QVariantList params);
+
+private:
+    void enqueue(const std::function<void()> &task, QSemaphore *done = 0);
+    void runBlocking(const std::function<void()> &task);
+    void recordCall(qint64 queueLatency, qint64 executionTime);
+
+    BaseExtension *mExtension;
+    QThread *mThread;
+    bool mDedicatedThread;
+    QObject *mInvoker;
+
+    QAtomicInt mQueueDepth;
+    mutable QMutex mStatisticsMutex;
+    int mPeakQueueDepth;
+    quint64 mCalls;
+    qint64 mTotalQueueLatency;
+    qint64 mMaxQueueLatency;
+    qint64 mTotalExecutionTime;
+};
+
+} // namespace luna
+
+#endif // EXTENSIONDISPATCHER_H
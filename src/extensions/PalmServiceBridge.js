@@ -2,6 +2,7 @@
 
 var __PalmSericeBridgeInstanceCounter = 0;
 var __PalmServiceBridgeInstances = {};
+var __PalmServiceBridgeResponseChunks = {};
 
 __PalmServiceBridge_handleServiceResponse = function(instanceId, response) {
     var instance = __PalmServiceBridgeInstances[instanceId];
@@ -11,6 +12,23 @@ __PalmServiceBridge_handleServiceResponse = function(instanceId, response) {
     instance.onservicecallback(response);
 }
 
+/* Large responses are delivered in several chunks which are reassembled here */
+__PalmServiceBridge_handleServiceResponseChunk = function(instanceId, chunk, last) {
+    var chunks = __PalmServiceBridgeResponseChunks[instanceId];
+    if (typeof chunks == "undefined") {
+        chunks = [];
+        __PalmServiceBridgeResponseChunks[instanceId] = chunks;
+    }
+
+    chunks.push(chunk);
+
+    if (!last)
+        return;
+
+    delete __PalmServiceBridgeResponseChunks[instanceId];
+    __PalmServiceBridge_handleServiceResponse(instanceId, chunks.join(""));
+}
+
 function PalmServiceBridge() {
     this.onservicecallback = function(msg) { };
 
@@ -27,6 +45,7 @@ PalmServiceBridge.prototype.version = function() {
 }
 
 PalmServiceBridge.prototype.destroy = function() {
+    delete __PalmServiceBridgeResponseChunks[this.instanceId];
     _webOS.execWithoutCallback("PalmServiceBridge", "releaseInstance", [this.instanceId]);
 }
 
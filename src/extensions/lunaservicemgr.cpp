@@ -8,38 +8,65 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <QString>
+#include <QTimer>
 
 #include "lunaservicemgr.h"
+#include "../lunaservicethread.h"
+#include "../eventtrace.h"
 
 namespace luna
 {
 
+static LunaServiceManager* s_instance = 0;
+
+LunaServiceManagerListener::~LunaServiceManagerListener()
+{
+    if (s_instance && (listenerToken || queued))
+        s_instance->cancel(this);
+}
+
 /** 
-* @brief Internal callback for service responses.
+* @brief Internal callback for service responses, runs on the luna service thread.
 * 
 * @param  sh 
 * @param  reply 
-* @param  ctx 
+* @param  ctx the BusCall the reply belongs to
 * 
 * @retval
 */
-static bool 
-message_filter(LSHandle *sh, LSMessage* reply, void* ctx)
+bool LunaServiceManager::messageFilter(LSHandle *sh, LSMessage* reply, void* ctx)
 {
-    const char* payload = LSMessageGetPayload(reply);
-
-    LunaServiceManagerListener* listener = (LunaServiceManagerListener*)ctx;
-
-    if (listener) {
-        listener->serviceResponse(payload);
-        return true;
-    }
+    BusCall* call = static_cast<BusCall*>(ctx);
+
+    // Only take a copy of the payload and what the listener's decoder makes
+    // of it and hand it over to the GUI thread where the listener lives.
+    QByteArray payload(LSMessageGetPayload(reply));
+    QString decoded;
+    if (call->decoder)
+        decoded = call->decoder(payload.constData());
+
+    EventTrace::record(TraceLunaReply, payload.size(), LSMessageGetResponseToken(reply),
+                       LSMessageGetSenderServiceName(reply));
+
+    LunaServiceManager* manager = call->manager;
+    LunaServiceManagerListener* listener = call->listener;
+    LSMessageToken serial = call->serial;
+    bool hasDecoder = call->decoder != 0;
+
+    // Replies of canceled or superseded calls are dropped
+    LunaServiceThread::instance()->post(manager->receiverId, [=]() {
+        if (!manager->activeListeners.contains(listener) || listener->listenerToken != serial)
+            return;
+
+        if (hasDecoder)
+            listener->decodedServiceResponse(payload.constData(), decoded);
+        else
+            listener->serviceResponse(payload.constData());
+    });
 
-    return false;
+    return true;
 }
 
-LunaServiceManager* s_instance = 0;
-
 /** 
 * @brief Obtains the singleton LunaServiceManager.
 * 
@@ -76,11 +103,33 @@ LunaServiceManager::LunaServiceManager() :
     , publicBusHighPriority(0)
     , privateBusHighPriority(0)
     , palmServiceHandleHighPriority(0)
+    , nextSerial(1)
+    , holdPeriod(0)
 {
+    receiverId = LunaServiceThread::instance()->registerReceiver();
 }
 
 LunaServiceManager::~LunaServiceManager()
 {
+    LunaServiceThread::instance()->unregisterReceiver(receiverId);
+
+    Q_FOREACH(ServiceWatch *watch, serviceWatches) {
+        delete watch->timeout;
+
+        // the cookie is only known on the service thread
+        LunaServiceThread::instance()->schedule([=]() {
+            if (watch->cookie) {
+                LSError lserror;
+                LSErrorInit(&lserror);
+                if (!LSCancelServerStatus(watch->sh, watch->cookie, &lserror))
+                    LSErrorFree(&lserror);
+            }
+
+            delete watch;
+        });
+    }
+    serviceWatches.clear();
+
     // ED : Close the single connection to DBUS.
     if (palmServiceHandle) {
         bool retVal;
@@ -112,7 +161,7 @@ bool LunaServiceManager::init()
         goto error;
 
     init = LSGmainAttachPalmService(palmServiceHandle,
-            g_main_loop_new(g_main_context_default(), TRUE), &lserror);
+            g_main_loop_new(LunaServiceThread::instance()->context(), TRUE), &lserror);
     if (!init) 
         goto error;
 
@@ -136,7 +185,7 @@ bool LunaServiceManager::init()
         goto error;
 
     init = LSGmainAttachPalmService(palmServiceHandleHighPriority,
-            g_main_loop_new(g_main_context_default(), TRUE), &lserror);
+            g_main_loop_new(LunaServiceThread::instance()->context(), TRUE), &lserror);
     if (!init) 
         goto error;
 
@@ -161,7 +210,7 @@ bool LunaServiceManager::init()
         goto error;
 
     init = LSGmainAttachPalmService(palmServiceHandleMediumPriority,
-            g_main_loop_new(g_main_context_default(), TRUE), &lserror);
+            g_main_loop_new(LunaServiceThread::instance()->context(), TRUE), &lserror);
     if (!init)
         goto error;
 
@@ -191,6 +240,53 @@ error:
     return init;
 }
 
+/** 
+* @brief Extracts the service name from a luna:// or palm:// uri.
+* 
+* @param  uri 
+* 
+* @retval the service name or an empty array if the uri is malformed.
+*/
+static QByteArray serviceNameFromUri(const char* uri)
+{
+    QByteArray name(uri);
+
+    int schemeEnd = name.indexOf("://");
+    if (schemeEnd < 0)
+        return QByteArray();
+
+    name = name.mid(schemeEnd + 3);
+
+    int pathStart = name.indexOf('/');
+    if (pathStart >= 0)
+        name.truncate(pathStart);
+
+    return name;
+}
+
+/** 
+* @brief Holds back calls to services which are not yet available for a while.
+* 
+* @param  period time in milliseconds from now until which calls are held back.
+*/
+void LunaServiceManager::holdCallsToUnavailableServices(int period)
+{
+    // Never cut an earlier hold short
+    if (period <= remainingHoldTime())
+        return;
+
+    holdClock.start();
+    holdPeriod = period;
+}
+
+int LunaServiceManager::remainingHoldTime() const
+{
+    if (!holdClock.isValid())
+        return 0;
+
+    return qMax<qint64>(0, holdPeriod - holdClock.elapsed());
+}
+
 /** 
 * @brief This method will make the async call to DBUS.
 * 
@@ -198,16 +294,14 @@ error:
 * @param  payload 
 * @param  inListener 
 * 
-* @retval 0 if message could not be sent.
-* @retval >0 serial number for the message.
+* @retval 0 if the call was queued until the target service becomes
+*         available (inListener->queued is set then) or has no listener.
+* @retval >0 serial number for the call. A failure to send it is reported
+*         to the listener later on as an error response.
 */
 unsigned long LunaServiceManager::call(const char* uri, const char* payload, LunaServiceManagerListener* inListener,
                                        const char* callerId, bool usePrivateBus)
 {
-    bool retVal;
-    LSError lserror;
-    LSErrorInit(&lserror);
-    LSMessageToken token = 0;
     LSHandle* serviceHandle = 0;
 
     if (callerId && (!(*callerId)))
@@ -237,27 +331,221 @@ unsigned long LunaServiceManager::call(const char* uri, const char* payload, Lun
             serviceHandle = privateBus;
     }
 
-    if (!inListener)
-        retVal = LSCallFromApplication(serviceHandle, uri, payload, callerId, 0, 0, &token, &lserror);
-    else {
-        retVal = LSCallFromApplication(serviceHandle, uri, payload, callerId, message_filter, inListener, &token, &lserror);
-        if (retVal) {
-            inListener->listenerToken = token;
-            inListener->sh = serviceHandle;
-        }
+    // Without a listener nobody waits for the reply so there is nothing we
+    // could hold back in a meaningful way.
+    int holdTime = remainingHoldTime();
+    if (holdTime == 0 || !inListener)
+        return dispatchCall(serviceHandle, uri, payload, inListener, callerId);
+
+    QByteArray serviceName = serviceNameFromUri(uri);
+    if (serviceName.isEmpty())
+        return dispatchCall(serviceHandle, uri, payload, inListener, callerId);
+
+    ServiceWatch* watch = watchService(serviceHandle, serviceName);
+    if (!watch || watch->connected)
+        return dispatchCall(serviceHandle, uri, payload, inListener, callerId);
+
+    PendingCall pending;
+    pending.uri = uri;
+    pending.payload = payload;
+    pending.callerId = callerId ? callerId : "";
+    pending.listener = inListener;
+    watch->pendingCalls.append(pending);
+
+    inListener->queued = true;
+    inListener->listenerToken = 0;
+
+    if (!watch->timeout->isActive())
+        watch->timeout->start(holdTime);
+
+    return 0;
+}
+
+unsigned long LunaServiceManager::dispatchCall(LSHandle* serviceHandle, const char* uri, const char* payload,
+                                               LunaServiceManagerListener* inListener, const char* callerId)
+{
+    if (callerId && (!(*callerId)))
+        callerId = 0;
+
+    QByteArray uriData(uri);
+    QByteArray payloadData(payload);
+    QByteArray callerIdData(callerId ? callerId : "");
+
+    BusCall* call = 0;
+    LSMessageToken serial = 0;
+
+    if (inListener) {
+        inListener->queued = false;
+
+        // The listener only takes replies for its new call from now on so
+        // don't keep the previous one open on the bus
+        if (activeListeners.contains(inListener) && inListener->listenerToken)
+            cancelCall(inListener->listenerToken);
+
+        // The serial is handed out right away; the bus token is only known
+        // once the service thread made the call
+        call = new BusCall;
+        call->manager = this;
+        call->listener = inListener;
+        call->serial = serial = nextSerial++;
+        call->sh = serviceHandle;
+        call->token = LSMESSAGE_TOKEN_INVALID;
+        call->decoder = inListener->responseDecoder();
+
+        inListener->listenerToken = serial;
+        inListener->sh = serviceHandle;
+        activeListeners.insert(inListener);
     }
 
-    if (!retVal) {
-        g_warning("LSCallFromApplication ERROR %d: %s (%s @ %s:%d)",
+    LunaServiceThread::instance()->schedule([=]() {
+        LSError lserror;
+        LSErrorInit(&lserror);
+        LSMessageToken token = LSMESSAGE_TOKEN_INVALID;
+
+        bool retVal = LSCallFromApplication(serviceHandle, uriData.constData(), payloadData.constData(),
+                                            callerIdData.isEmpty() ? 0 : callerIdData.constData(),
+                                            call ? &LunaServiceManager::messageFilter : 0, call,
+                                            &token, &lserror);
+        if (!retVal) {
+            g_warning("LSCallFromApplication ERROR %d: %s (%s @ %s:%d)",
+                lserror.error_code, lserror.message,
+                lserror.func, lserror.file, lserror.line);
+            LSErrorFree(&lserror);
+        }
+
+        if (!call)
+            return;
+
+        if (!retVal) {
+            LunaServiceManagerListener* listener = call->listener;
+            LSMessageToken serial = call->serial;
+            delete call;
+
+            LunaServiceThread::instance()->post(receiverId, [=]() {
+                callFailed(listener, serial);
+            });
+            return;
+        }
+
+        call->token = token;
+        busCalls.insert(call->serial, call);
+    });
+
+    return serial;
+}
+
+/** 
+* @brief Tells the listener its call couldn't be sent unless it moved on meanwhile.
+*/
+void LunaServiceManager::callFailed(LunaServiceManagerListener* listener, LSMessageToken serial)
+{
+    if (!activeListeners.contains(listener) || listener->listenerToken != serial)
+        return;
+
+    activeListeners.remove(listener);
+    listener->listenerToken = 0;
+
+    listener->serviceResponse("{\"returnValue\":false,\"errorCode\":-1,"
+                              "\"errorText\":\"Failed to send message\"}");
+}
+
+/** 
+* @brief Returns the watch tracking the availability of a service and creates it
+*        if the service isn't tracked yet.
+* 
+* @retval 0 if the service status could not be registered.
+*/
+LunaServiceManager::ServiceWatch* LunaServiceManager::watchService(LSHandle* serviceHandle,
+                                                                   const QByteArray& serviceName)
+{
+    QByteArray key = serviceName + "@" + QByteArray::number((qulonglong) serviceHandle);
+
+    if (serviceWatches.contains(key))
+        return serviceWatches.value(key);
+
+    ServiceWatch* watch = new ServiceWatch;
+    watch->manager = this;
+    watch->serviceName = serviceName;
+    watch->sh = serviceHandle;
+    watch->cookie = 0;
+    watch->connected = false;
+
+    LunaServiceThread::instance()->schedule([=]() {
+        LSError lserror;
+        LSErrorInit(&lserror);
+
+        if (LSRegisterServerStatusEx(serviceHandle, serviceName.constData(), serverStatusCallback,
+                                     watch, &watch->cookie, &lserror))
+            return;
+
+        g_warning("LSRegisterServerStatusEx ERROR %d: %s (%s @ %s:%d)",
             lserror.error_code, lserror.message,
             lserror.func, lserror.file, lserror.line);
         LSErrorFree(&lserror);
-        token = 0;
-        goto error;
+
+        // We can't tell when the service comes up so don't hold calls for it
+        LunaServiceThread::instance()->post(receiverId, [=]() {
+            watch->connected = true;
+            flushPendingCalls(watch);
+        });
+    });
+
+    // Calls are held back on the GUI thread so the timeout runs there as well
+    watch->timeout = new QTimer;
+    watch->timeout->setSingleShot(true);
+    QObject::connect(watch->timeout, &QTimer::timeout, [=]() {
+        failPendingCalls(watch);
+    });
+
+    serviceWatches.insert(key, watch);
+
+    return watch;
+}
+
+bool LunaServiceManager::serverStatusCallback(LSHandle* sh, const char* serviceName, bool connected, void* ctx)
+{
+    ServiceWatch* watch = static_cast<ServiceWatch*>(ctx);
+    LunaServiceManager* manager = watch->manager;
+
+    LunaServiceThread::instance()->post(manager->receiverId, [=]() {
+        watch->connected = connected;
+        if (connected)
+            manager->flushPendingCalls(watch);
+    });
+
+    return true;
+}
+
+void LunaServiceManager::flushPendingCalls(ServiceWatch* watch)
+{
+    watch->timeout->stop();
+
+    // Take the calls one by one from the live list: a response may delete
+    // other listeners which then drop their calls from it
+    while (!watch->pendingCalls.isEmpty()) {
+        PendingCall pending = watch->pendingCalls.takeFirst();
+        dispatchCall(watch->sh, pending.uri.constData(), pending.payload.constData(),
+                     pending.listener, pending.callerId.constData());
     }
+}
 
-error:
-    return token;
+void LunaServiceManager::failPendingCalls(ServiceWatch* watch)
+{
+    if (watch->pendingCalls.isEmpty())
+        return;
+
+    g_warning("Service %s did not become available in time, failing %d pending calls",
+              watch->serviceName.constData(), watch->pendingCalls.count());
+
+    QByteArray response = QByteArray("{\"returnValue\":false,\"errorCode\":-1,\"errorText\":\"Service ") +
+                          watch->serviceName + " is not available\"}";
+
+    // Reply directly instead of sending the calls to the bus just to see them fail
+    while (!watch->pendingCalls.isEmpty()) {
+        PendingCall pending = watch->pendingCalls.takeFirst();
+        pending.listener->queued = false;
+        pending.listener->serviceResponse(response.constData());
+    }
 }
 
 /** 
@@ -269,22 +557,51 @@ error:
  */
 void LunaServiceManager::cancel(LunaServiceManagerListener* inListener)
 {
-    LSError lserror;
+    if (inListener && inListener->queued) {
+        Q_FOREACH(ServiceWatch *watch, serviceWatches) {
+            for (int n = watch->pendingCalls.count() - 1; n >= 0; n--) {
+                if (watch->pendingCalls.at(n).listener == inListener)
+                    watch->pendingCalls.removeAt(n);
+            }
+        }
+
+        inListener->queued = false;
+        return;
+    }
 
     if (!inListener || !inListener->listenerToken)
         return;
 
-    LSErrorInit(&lserror);
+    activeListeners.remove(inListener);
 
-    if (!LSCallCancel(inListener->sh, inListener->listenerToken, &lserror)) {
-        g_warning("LSCallCancel ERROR %d: %s (%s @ %s:%d)",
-            lserror.error_code, lserror.message,
-            lserror.func, lserror.file, lserror.line);
-        LSErrorFree(&lserror);
-    }
+    cancelCall(inListener->listenerToken);
 
     // set the token to zero to indicate we have been canceled
     inListener->listenerToken = 0;
 }
 
+void LunaServiceManager::cancelCall(LSMessageToken serial)
+{
+    // Runs after the call itself was made as scheduled functions keep their
+    // order; a call which failed to be sent isn't known anymore
+    LunaServiceThread::instance()->schedule([=]() {
+        BusCall* call = busCalls.take(serial);
+        if (!call)
+            return;
+
+        LSError lserror;
+        LSErrorInit(&lserror);
+
+        bool canceled = LSCallCancel(call->sh, call->token, &lserror);
+        delete call;
+
+        if (!canceled) {
+            g_warning("LSCallCancel ERROR %d: %s (%s @ %s:%d)",
+                lserror.error_code, lserror.message,
+                lserror.func, lserror.file, lserror.line);
+            LSErrorFree(&lserror);
+        }
+    });
+}
+
 } // namespace luna
@@ -7,17 +7,41 @@
 #define LUNASERVICEMGR_H_
 
 #include <luna-service2/lunaservice.h>
+#include <glib.h>
+
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QSet>
+#include <QHash>
+#include <QString>
+#include <QElapsedTimer>
+
+class QTimer;
 
 namespace luna
 {
 
 struct LunaServiceManagerListener
 {
-    LunaServiceManagerListener() : listenerToken(LSMESSAGE_TOKEN_INVALID), sh(0) { }
-    virtual ~LunaServiceManagerListener() { }
+    // Prepares a reply on the service thread. It only gets the reply and
+    // must not touch the listener which might be gone meanwhile.
+    typedef QString (*ResponseDecoder)(const char* body);
+
+    LunaServiceManagerListener() : listenerToken(LSMESSAGE_TOKEN_INVALID), sh(0), queued(false) { }
+    // cancels a call which is still active so the manager never keeps a
+    // listener which is gone
+    virtual ~LunaServiceManagerListener();
     virtual void serviceResponse(const char* body) = 0;
+    // Replies are passed here with what the decoder made of them when the
+    // listener has one
+    virtual ResponseDecoder responseDecoder() const { return 0; }
+    virtual void decodedServiceResponse(const char* body, const QString& decoded) { Q_UNUSED(decoded); serviceResponse(body); }
+    // the serial of the call the manager hands out, not the one of the bus
     LSMessageToken listenerToken;
     LSHandle* sh;
+    // set while the call waits for its target service to become available
+    bool queued;
 };
 
 
@@ -25,7 +49,9 @@ struct LunaServiceManagerListener
 //  LunaServiceManager
 //
 // This class is a singleton which handles all the client requests
-// for a WebKit instance.
+// for a WebKit instance. The bus connections are served by the
+// LunaServiceThread and all calls on them are made there. The manager
+// itself is only used from the GUI thread, listeners are called there.
 
 class LunaServiceManager
 {
@@ -36,10 +62,70 @@ public:
     unsigned long call(const char* uri, const char* payload, LunaServiceManagerListener*, const char* callerId, bool usePrivateBus = false);
     void cancel(LunaServiceManagerListener*);
 
+    // For the next period (in milliseconds) calls to a service which isn't
+    // registered on the bus yet are held back until the service comes up or
+    // the period is over. Afterwards every call goes to the bus immediately.
+    void holdCallsToUnavailableServices(int period);
+
 private:
+    // Owned by the service thread from the moment the call is scheduled
+    struct BusCall
+    {
+        LunaServiceManager* manager;
+        LunaServiceManagerListener* listener;
+        LSMessageToken serial;
+        LSHandle* sh;
+        LSMessageToken token;
+        LunaServiceManagerListener::ResponseDecoder decoder;
+    };
+
+    struct PendingCall
+    {
+        QByteArray uri;
+        QByteArray payload;
+        QByteArray callerId;
+        LunaServiceManagerListener* listener;
+    };
+
+    struct ServiceWatch
+    {
+        LunaServiceManager* manager;
+        QByteArray serviceName;
+        LSHandle* sh;
+        void* cookie;
+        bool connected;
+        QTimer* timeout;
+        QList<PendingCall> pendingCalls;
+    };
+
     bool init();
     LunaServiceManager();
 
+    unsigned long dispatchCall(LSHandle* serviceHandle, const char* uri, const char* payload,
+                               LunaServiceManagerListener*, const char* callerId);
+    ServiceWatch* watchService(LSHandle* serviceHandle, const QByteArray& serviceName);
+    void cancelCall(LSMessageToken serial);
+    void callFailed(LunaServiceManagerListener* listener, LSMessageToken serial);
+    void flushPendingCalls(ServiceWatch* watch);
+    void failPendingCalls(ServiceWatch* watch);
+
+    static bool serverStatusCallback(LSHandle* sh, const char* serviceName, bool connected, void* ctx);
+    static bool messageFilter(LSHandle* sh, LSMessage* reply, void* ctx);
+
+    int receiverId;
+    // listeners with a call on the bus, one entry per listener as a new
+    // call of a listener replaces its previous one
+    QSet<LunaServiceManagerListener*> activeListeners;
+    LSMessageToken nextSerial;
+    // calls on the bus by serial, only used on the service thread
+    QHash<LSMessageToken, BusCall*> busCalls;
+
+    int remainingHoldTime() const;
+
+    QElapsedTimer holdClock;
+    int holdPeriod;
+    QMap<QByteArray, ServiceWatch*> serviceWatches;
+
     LSHandle* publicBus;
     LSHandle* privateBus;
     LSPalmService* palmServiceHandle;
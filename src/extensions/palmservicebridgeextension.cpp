@@ -20,25 +20,120 @@
 
 #include "../webapplication.h"
 #include "../webapplicationwindow.h"
+#include "../bridgestatistics.h"
 #include "palmservicebridgeextension.h"
 
+// Responses bigger than this are handed to the page in chunks, one chunk per
+// frame, so that neither the UI nor the web process block on a single huge
+// script evaluation.
+#define STREAMING_THRESHOLD     (256 * 1024)
+#define STREAMING_CHUNK_SIZE    (64 * 1024)
+#define STREAMING_INTERVAL_MS   16
+
 namespace luna
 {
 
+static QString quoteForScript(const QString &str)
+{
+    QString quoted;
+    quoted.reserve(str.size() + 2);
+    quoted.append(QLatin1Char('"'));
+
+    for (int n = 0; n < str.size(); n++) {
+        const QChar c = str.at(n);
+        switch (c.unicode()) {
+        case '"':
+            quoted.append(QLatin1String("\\\""));
+            break;
+        case '\\':
+            quoted.append(QLatin1String("\\\\"));
+            break;
+        case '\n':
+            quoted.append(QLatin1String("\\n"));
+            break;
+        case '\r':
+            quoted.append(QLatin1String("\\r"));
+            break;
+        case 0x2028:
+            quoted.append(QLatin1String("\\u2028"));
+            break;
+        case 0x2029:
+            quoted.append(QLatin1String("\\u2029"));
+            break;
+        default:
+            quoted.append(c);
+            break;
+        }
+    }
+
+    quoted.append(QLatin1Char('"'));
+    return quoted;
+}
+
 PalmServiceBridge::PalmServiceBridge(int instanceId, const QString& identifier, bool usePrivateBus, QObject *parent) :
     QObject(parent),
     mInstanceId(instanceId),
     mCanceled(false),
     mUsePrivateBus(usePrivateBus),
     mIdentifier(identifier),
-    mCallActive(false)
+    mCallActive(false),
+    mStreamingEnabled(false),
+    mAwaitingResponse(false)
 {
 }
 
+PalmServiceBridge::~PalmServiceBridge()
+{
+    if (listenerToken || queued)
+        LunaServiceManager::instance()->cancel(this);
+}
+
+void PalmServiceBridge::setStreamingEnabled(bool enabled)
+{
+    mStreamingEnabled = enabled;
+}
+
+void PalmServiceBridge::recordResponse(const char *body)
+{
+    // Only the first response answers the call, later ones are updates of
+    // a subscription and would just measure how long it's running
+    BridgeStatistics::instance()->recordResponse(mIdentifier, "PalmServiceBridge", mUri,
+                                                 mAwaitingResponse ? mCallTimer.nsecsElapsed() / 1000 : -1,
+                                                 body == NULL ? 0 : qstrlen(body));
+    mAwaitingResponse = false;
+}
+
+QString PalmServiceBridge::encodeResponse(const char *body)
+{
+    // Same encoding as the direct and streamed responses of the extension
+    return quoteForScript(QString::fromUtf8(body == NULL ? "" : body));
+}
+
+LunaServiceManagerListener::ResponseDecoder PalmServiceBridge::responseDecoder() const
+{
+    // Streamed responses are converted chunk by chunk by the extension
+    return mStreamingEnabled ? 0 : &PalmServiceBridge::encodeResponse;
+}
+
 void PalmServiceBridge::serviceResponse(const char *body)
 {
-    QString arguments = QString("'%1'").arg((body == NULL ? "" : body));
-    callback(arguments);
+    recordResponse(body);
+
+    if (mStreamingEnabled) {
+        responseReceived(QByteArray(body == NULL ? "" : body));
+        mCallActive = false;
+        return;
+    }
+
+    callback(encodeResponse(body));
+    mCallActive = false;
+}
+
+void PalmServiceBridge::decodedServiceResponse(const char *body, const QString &decoded)
+{
+    recordResponse(body);
+
+    callback(decoded);
     mCallActive = false;
 }
 
@@ -53,11 +148,18 @@ void PalmServiceBridge::call(const QString &uri, const QString &payload)
     LunaServiceManager *mgr = LunaServiceManager::instance();
 
     mCanceled = false;
+    mUri = uri;
+    mCallTimer.start();
+    mAwaitingResponse = true;
 
     mgr->call(uri.toUtf8().constData(), payload.toUtf8().constData(),
               this, mIdentifier.toUtf8().constData(), mUsePrivateBus);
 
-    if (LSMESSAGE_TOKEN_INVALID == listenerToken) {
+    BridgeStatistics::instance()->recordCall(mIdentifier, "PalmServiceBridge", uri,
+                                             BridgeStatistics::AsynchronousCall,
+                                             mCallTimer.nsecsElapsed() / 1000, payload.size(), 0);
+
+    if (LSMESSAGE_TOKEN_INVALID == listenerToken && !queued) {
         cancel();
         callback("");
         mCallActive = false;
@@ -71,7 +173,7 @@ void PalmServiceBridge::cancel()
         return;
 
     mCanceled = true;
-    if (listenerToken)
+    if (listenerToken || queued)
         LunaServiceManager::instance()->cancel(this);
 
     mCallActive = false;
@@ -86,9 +188,21 @@ int PalmServiceBridge::instanceId() const
 
 PalmServiceBridgeExtension::PalmServiceBridgeExtension(WebApplicationWindow *applicationWindow, QObject *parent) :
     BaseExtension("PalmServiceBridge", applicationWindow, parent),
-    mApplicationWindow(applicationWindow)
+    mApplicationWindow(applicationWindow),
+    mChunkTimer(this),
+    mBufferedBytes(0),
+    mPeakBufferedBytes(0)
 {
     applicationWindow->registerUserScript(QUrl("qrc:///extensions/PalmServiceBridge.js"));
+
+    mChunkTimer.setInterval(STREAMING_INTERVAL_MS);
+    connect(&mChunkTimer, SIGNAL(timeout()), this, SLOT(deliverNextChunk()));
+}
+
+PalmServiceBridgeExtension::~PalmServiceBridgeExtension()
+{
+    if (mPeakBufferedBytes > 0)
+        qDebug() << "Streamed service responses buffered up to" << mPeakBufferedBytes << "bytes";
 }
 
 bool PalmServiceBridgeExtension::isPrivilegedApplcation(const QString& id)
@@ -106,6 +220,8 @@ void PalmServiceBridgeExtension::createInstance(unsigned int instanceId)
     PalmServiceBridge *bridge = new PalmServiceBridge(instanceId, mApplicationWindow->application()->id(),
                                                       isPrivilegedApplcation(mApplicationWindow->application()->id()));
     connect(bridge, SIGNAL(callback(QString)), this, SLOT(callbackFromBridge(QString)));
+    connect(bridge, SIGNAL(responseReceived(QByteArray)), this, SLOT(responseFromBridge(QByteArray)));
+    bridge->setStreamingEnabled(mApplicationWindow->application()->streamServiceResponses());
     mBridgeInstances.insert(instanceId, bridge);
 }
 
@@ -116,6 +232,14 @@ void PalmServiceBridgeExtension::releaseInstance(unsigned int instanceId)
 
     PalmServiceBridge *bridge = mBridgeInstances.take(instanceId);
     bridge->deleteLater();
+
+    for (int n = mStreamedResponses.count() - 1; n >= 0; n--) {
+        if (mStreamedResponses.at(n).instanceId != instanceId)
+            continue;
+
+        mBufferedBytes -= mStreamedResponses.at(n).payload.size() * sizeof(QChar);
+        mStreamedResponses.removeAt(n);
+    }
 }
 
 void PalmServiceBridgeExtension::callbackFromBridge(const QString &arguments)
@@ -127,6 +251,82 @@ void PalmServiceBridgeExtension::callbackFromBridge(const QString &arguments)
     mAppEnvironment->executeScript(command);
 }
 
+bool PalmServiceBridgeExtension::hasStreamedResponse(unsigned int instanceId) const
+{
+    Q_FOREACH(const StreamedResponse &response, mStreamedResponses) {
+        if (response.instanceId == instanceId)
+            return true;
+    }
+
+    return false;
+}
+
+void PalmServiceBridgeExtension::responseFromBridge(const QByteArray &body)
+{
+    PalmServiceBridge *bridge = static_cast<PalmServiceBridge*>(sender());
+    unsigned int instanceId = bridge->instanceId();
+
+    // Small responses go out directly unless they would overtake a response
+    // for the same instance which is still being streamed
+    if (body.size() < STREAMING_THRESHOLD && !hasStreamedResponse(instanceId)) {
+        QString command = QString("__PalmServiceBridge_handleServiceResponse(%1, %2);")
+                .arg(instanceId).arg(quoteForScript(QString::fromUtf8(body)));
+        mAppEnvironment->executeScript(command);
+        return;
+    }
+
+    StreamedResponse response;
+    response.instanceId = instanceId;
+    response.payload = QString::fromUtf8(body);
+    response.offset = 0;
+    mStreamedResponses.append(response);
+
+    mBufferedBytes += response.payload.size() * sizeof(QChar);
+    if (mBufferedBytes > mPeakBufferedBytes)
+        mPeakBufferedBytes = mBufferedBytes;
+
+    if (!mChunkTimer.isActive()) {
+        deliverNextChunk();
+        mChunkTimer.start();
+    }
+}
+
+void PalmServiceBridgeExtension::deliverNextChunk()
+{
+    if (mStreamedResponses.isEmpty()) {
+        mChunkTimer.stop();
+        return;
+    }
+
+    StreamedResponse &response = mStreamedResponses.first();
+
+    int length = qMin(STREAMING_CHUNK_SIZE, response.payload.size() - response.offset);
+
+    // never split a surrogate pair across two chunks
+    if (response.offset + length < response.payload.size() &&
+        response.payload.at(response.offset + length - 1).isHighSurrogate())
+        length--;
+
+    bool last = (response.offset + length >= response.payload.size());
+
+    QString command = QString("__PalmServiceBridge_handleServiceResponseChunk(%1, %2, %3);")
+            .arg(response.instanceId)
+            .arg(quoteForScript(response.payload.mid(response.offset, length)))
+            .arg(last ? "true" : "false");
+    mAppEnvironment->executeScript(command);
+
+    response.offset += length;
+
+    if (!last)
+        return;
+
+    mBufferedBytes -= response.payload.size() * sizeof(QChar);
+    mStreamedResponses.removeFirst();
+
+    if (mStreamedResponses.isEmpty())
+        mChunkTimer.stop();
+}
+
 void PalmServiceBridgeExtension::call(unsigned int instanceId, const QString& uri, const QString& payload)
 {
     if (!mBridgeInstances.contains(instanceId))
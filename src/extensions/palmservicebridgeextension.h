@@ -20,6 +20,8 @@
 
 #include <QObject>
 #include <QMap>
+#include <QTimer>
+#include <QElapsedTimer>
 
 #include <baseextension.h>
 
@@ -36,16 +38,22 @@ class PalmServiceBridge : public QObject,
     Q_OBJECT
 public:
     explicit PalmServiceBridge(int instanceId, const QString& identifier = "", bool usePrivateBus = false, QObject *parent = 0);
+    ~PalmServiceBridge();
 
     void call(const QString &uri, const QString &payload);
     void cancel();
 
+    void setStreamingEnabled(bool enabled);
+
     virtual void serviceResponse(const char* body);
+    virtual ResponseDecoder responseDecoder() const;
+    virtual void decodedServiceResponse(const char* body, const QString& decoded);
 
     int instanceId() const;
 
 Q_SIGNALS:
     void callback(const QString &arguments);
+    void responseReceived(const QByteArray &body);
 
 private:
     int mInstanceId;
@@ -53,6 +61,13 @@ private:
     bool mUsePrivateBus;
     QString mIdentifier;
     bool mCallActive;
+    bool mStreamingEnabled;
+    QString mUri;
+    QElapsedTimer mCallTimer;
+    bool mAwaitingResponse;
+
+    void recordResponse(const char* body);
+    static QString encodeResponse(const char* body);
 };
 
 class PalmServiceBridgeExtension : public BaseExtension
@@ -60,6 +75,7 @@ class PalmServiceBridgeExtension : public BaseExtension
     Q_OBJECT
 public:
     explicit PalmServiceBridgeExtension(WebApplicationWindow *applicationWindow, QObject *parent = 0);
+    ~PalmServiceBridgeExtension();
 
 public Q_SLOTS:
     void createInstance(unsigned int instanceId);
@@ -69,12 +85,26 @@ public Q_SLOTS:
 
 private Q_SLOTS:
     void callbackFromBridge(const QString &arguments);
+    void responseFromBridge(const QByteArray &body);
+    void deliverNextChunk();
 
 private:
+    struct StreamedResponse
+    {
+        unsigned int instanceId;
+        QString payload;
+        int offset;
+    };
+
     QMap<unsigned int, PalmServiceBridge*> mBridgeInstances;
     WebApplicationWindow *mApplicationWindow;
+    QList<StreamedResponse> mStreamedResponses;
+    QTimer mChunkTimer;
+    qint64 mBufferedBytes;
+    qint64 mPeakBufferedBytes;
 
     bool isPrivilegedApplcation(const QString& id);
+    bool hasStreamedResponse(unsigned int instanceId) const;
 };
 
 } // namespace luna
@@ -20,31 +20,75 @@
 #include <QJsonValue>
 #include <QQuickView>
 #include <QFile>
+#include <QFileInfo>
+#include <QHash>
 #include <QUrl>
 #include <QtWebKitVersion>
 
-#include <luna-service2++/message.hpp>
-#include <luna-service2++/call.hpp>
-
 #include <LocalePreferences.h>
 
 #include "../webapplication.h"
 #include "../webapplicationwindow.h"
 #include "../systemtime.h"
+#include "../jsonreader.h"
+#include "../eventtrace.h"
+#include "../lunaservicethread.h"
 #include "palmsystemextension.h"
 #include "deviceinfo.h"
 
 namespace luna
 {
 
+struct BannerRequest
+{
+    int receiver;
+    PalmSystemExtension *extension;
+    int bannerId;
+};
+
 PalmSystemExtension::PalmSystemExtension(WebApplicationWindow *applicationWindow, QObject *parent) :
     BaseExtension("PalmSystem", applicationWindow, parent),
     mApplicationWindow(applicationWindow),
-    mLunaPubHandle(NULL, true)
+    mLunaPubHandle(NULL, true),
+    mNextBannerId(1)
 {
-    applicationWindow->registerUserScript(QUrl("qrc:///extensions/PalmSystem.js"));
+    mReceiverId = LunaServiceThread::instance()->registerReceiver();
+    mLunaPubHandle.attachToLoop(LunaServiceThread::instance()->context());
+}
 
-    mLunaPubHandle.attachToLoop(g_main_context_default());
+PalmSystemExtension::~PalmSystemExtension()
+{
+    LunaServiceThread::instance()->unregisterReceiver(mReceiverId);
+
+    // The handle is served by the service thread so it has to go away there
+    // too, after the calls we scheduled on it
+    LS::Handle *handle = new LS::Handle(std::move(mLunaPubHandle));
+    LunaServiceThread::instance()->schedule([handle]() {
+        delete handle;
+    });
+}
+
+/**
+ * Sends a call to the notification service from the service thread without
+ * waiting for its reply.
+ */
+void PalmSystemExtension::callNotifications(const char *method, const QJsonObject &params)
+{
+    LSHandle *handle = mLunaPubHandle.get();
+    QByteArray uri = QByteArray("luna://org.webosports.notifications/") + method;
+    QByteArray payload = QJsonDocument(params).toJson();
+    QByteArray appId = mApplicationWindow->application()->id().toUtf8();
+
+    LunaServiceThread::instance()->schedule([=]() {
+        LSError lserror;
+        LSErrorInit(&lserror);
+
+        if (!LSCallFromApplicationOneReply(handle, uri.constData(), payload.constData(),
+                                           appId.constData(), 0, 0, 0, &lserror)) {
+            LSErrorPrint(&lserror, stderr);
+            LSErrorFree(&lserror);
+        }
+    });
 }
 
 void PalmSystemExtension::stageReady()
@@ -97,26 +141,27 @@ void PalmSystemExtension::removeBannerMessage(int id)
 {
     qDebug() << __PRETTY_FUNCTION__;
 
-    QString appId = mApplicationWindow->application()->id();
+    // Closed once the notification service told us which one it is
+    if (mPendingBanners.remove(id))
+        return;
 
-    QJsonObject params;
-    params.insert("id", id);
+    if (!mBannerNotifications.contains(id))
+        return;
 
-    QJsonDocument document(params);
+    QJsonObject params;
+    params.insert("id", mBannerNotifications.take(id));
 
-    LS::Call call = mLunaPubHandle.callOneReply("luna://org.webosports.notifications/closeNotification",
-                                                document.toJson().constData(),
-                                                appId.toUtf8().constData());
+    callNotifications("closeNotification", params);
 }
 
 void PalmSystemExtension::clearBannerMessages()
 {
     qDebug() << __PRETTY_FUNCTION__;
 
-    QString appId = mApplicationWindow->application()->id();
+    mPendingBanners.clear();
+    mBannerNotifications.clear();
 
-    LS::Call call = mLunaPubHandle.callOneReply("luna://org.webosports.notifications/closeAllNotifications",
-                                                "{}", appId.toUtf8().constData());
+    callNotifications("closeAllNotifications", QJsonObject());
 }
 
 void PalmSystemExtension::keepAlive(bool keep)
@@ -137,76 +182,123 @@ void PalmSystemExtension::setProperty(const QString &name, const QVariant &value
     qDebug() << __PRETTY_FUNCTION__ << name << value;
 }
 
-QString PalmSystemExtension::getProperty(const QJsonArray &params)
+static QHash<QString, PalmSystemExtension::Property> createPropertyTable()
 {
-    qDebug() << __PRETTY_FUNCTION__ << params;
+    QHash<QString, PalmSystemExtension::Property> properties;
+
+    properties.insert("launchParams", PalmSystemExtension::LaunchParamsProperty);
+    properties.insert("hasAlphaHole", PalmSystemExtension::HasAlphaHoleProperty);
+    properties.insert("locale", PalmSystemExtension::LocaleProperty);
+    properties.insert("locales.UI", PalmSystemExtension::LocaleProperty);
+    properties.insert("localeRegion", PalmSystemExtension::LocaleRegionProperty);
+    properties.insert("timeFormat", PalmSystemExtension::TimeFormatProperty);
+    properties.insert("timeZone", PalmSystemExtension::TimeZoneProperty);
+    properties.insert("timezone", PalmSystemExtension::TimeZoneProperty);
+    properties.insert("isMinimal", PalmSystemExtension::IsMinimalProperty);
+    properties.insert("identifier", PalmSystemExtension::IdentifierProperty);
+    properties.insert("screenOrientation", PalmSystemExtension::OrientationProperty);
+    properties.insert("windowOrientation", PalmSystemExtension::OrientationProperty);
+    properties.insert("specifiedWindowOrientation", PalmSystemExtension::OrientationProperty);
+    properties.insert("videoOrientation", PalmSystemExtension::OrientationProperty);
+    properties.insert("deviceInfo", PalmSystemExtension::DeviceInfoProperty);
+    properties.insert("isActivated", PalmSystemExtension::IsActivatedProperty);
+    properties.insert("activityId", PalmSystemExtension::ActivityIdProperty);
+    properties.insert("phoneRegion", PalmSystemExtension::PhoneRegionProperty);
+    properties.insert("version", PalmSystemExtension::VersionProperty);
+
+    return properties;
+}
+
+static QHash<QString, PalmSystemExtension::SynchronousFunction> createSynchronousFunctionTable()
+{
+    QHash<QString, PalmSystemExtension::SynchronousFunction> functions;
+
+    functions.insert("getResource", PalmSystemExtension::GetResourceFunction);
+    functions.insert("getIdentifierForFrame", PalmSystemExtension::GetIdentifierForFrameFunction);
+    functions.insert("getProperty", PalmSystemExtension::GetPropertyFunction);
+    functions.insert("addBannerMessage", PalmSystemExtension::AddBannerMessageFunction);
+
+    return functions;
+}
+
+/**
+ * Maps the property names the page asks for to the properties we know. A
+ * few of them have aliases used by different frameworks.
+ */
+PalmSystemExtension::Property PalmSystemExtension::propertyFromName(const QString &name)
+{
+    static const QHash<QString, Property> properties = createPropertyTable();
+    return properties.value(name, UnknownProperty);
+}
 
+PalmSystemExtension::SynchronousFunction PalmSystemExtension::synchronousFunctionFromName(const QString &name)
+{
+    static const QHash<QString, SynchronousFunction> functions = createSynchronousFunctionTable();
+    return functions.value(name, UnknownFunction);
+}
+
+QString PalmSystemExtension::getProperty(const QJsonArray &params)
+{
     if (params.count() != 1 || !params.at(0).isString())
         return QString("");
 
     QString name = params.at(0).toString();
-    QString result = "";
-
-    if (name == "launchParams")
-        result = mApplicationWindow->application()->parameters();
-    else if (name == "hasAlphaHole")
-        result = QString("false");
-    else if (name == "locale" || name == "locales.UI")
-        result = QString::fromStdString(LocalePreferences::instance()->locale());
-    else if (name == "localeRegion")
-        result = QString::fromStdString(LocalePreferences::instance()->localeRegion());
-    else if (name == "timeFormat")
-        result = QString::fromStdString(LocalePreferences::instance()->timeFormat());
-    else if (name == "timeZone" || name == "timezone")
-        result = SystemTime::instance()->timezone();
-    else if (name == "isMinimal")
-        result = QString("false");
-    else if (name == "identifier")
-        result = mApplicationWindow->application()->identifier();
-    else if (name == "screenOrientation")
-        result = QString("");
-    else if (name == "windowOrientation")
-        result = QString("");
-    else if (name == "specifiedWindowOrientation")
-        result = QString("");
-    else if (name == "videoOrientation")
-        result = QString("");
-    else if (name == "deviceInfo")
-        result = DeviceInfo::instance()->jsonString();
-    else if (name == "isActivated")
-        result = QString(mApplicationWindow->active() ? "true" : "false");
-    else if (name == "activityId")
-        result = QString("%1").arg(mApplicationWindow->application()->activityId());
-    else if (name == "phoneRegion")
-        result = QString::fromStdString(LocalePreferences::instance()->phoneRegion());
-    else if (name == "version")
-        result = QString(QTWEBKIT_VERSION_STR);
-
-    qDebug() << __PRETTY_FUNCTION__ << "result" << result;
-
-    return result;
+    EventTrace::record(TracePropertyRead, 0, 0, name);
+
+    switch (propertyFromName(name)) {
+    case LaunchParamsProperty:
+        return mApplicationWindow->application()->parameters();
+    case HasAlphaHoleProperty:
+    case IsMinimalProperty:
+        return QString("false");
+    case LocaleProperty:
+        return QString::fromStdString(LocalePreferences::instance()->locale());
+    case LocaleRegionProperty:
+        return QString::fromStdString(LocalePreferences::instance()->localeRegion());
+    case TimeFormatProperty:
+        return QString::fromStdString(LocalePreferences::instance()->timeFormat());
+    case TimeZoneProperty:
+        return SystemTime::instance()->timezone();
+    case IdentifierProperty:
+        return mApplicationWindow->application()->identifier();
+    case DeviceInfoProperty:
+        return DeviceInfo::instance()->jsonString();
+    case IsActivatedProperty:
+        return QString(mApplicationWindow->active() ? "true" : "false");
+    case ActivityIdProperty:
+        return QString("%1").arg(mApplicationWindow->application()->activityId());
+    case PhoneRegionProperty:
+        return QString::fromStdString(LocalePreferences::instance()->phoneRegion());
+    case VersionProperty:
+        return QString(QTWEBKIT_VERSION_STR);
+    case OrientationProperty:
+    case UnknownProperty:
+        break;
+    }
+
+    return QString("");
 }
 
 QString PalmSystemExtension::handleSynchronousCall(const QString& funcName, const QJsonArray& params)
 {
-    QString response = "{}";
-
-    if (funcName == "getResource")
-        response = getResource(params);
-    else if (funcName == "getIdentifierForFrame")
-        response = getIdentifierForFrame(params);
-    else if (funcName == "getProperty")
-        response = getProperty(params);
-    else if (funcName == "addBannerMessage")
-        response = addBannerMessage(params);
-
-    return response;
+    switch (synchronousFunctionFromName(funcName)) {
+    case GetResourceFunction:
+        return getResource(params);
+    case GetIdentifierForFrameFunction:
+        return getIdentifierForFrame(params);
+    case GetPropertyFunction:
+        return getProperty(params);
+    case AddBannerMessageFunction:
+        return addBannerMessage(params);
+    case UnknownFunction:
+        break;
+    }
+
+    return QString("{}");
 }
 
 QString PalmSystemExtension::getResource(const QJsonArray& params)
 {
-    qDebug() << __PRETTY_FUNCTION__ << params;
-
     if (params.count() != 2 || !params.at(0).isString())
         return QString("");
 
@@ -225,13 +317,13 @@ QString PalmSystemExtension::getResource(const QJsonArray& params)
 
     QByteArray data = file.readAll();
 
+    EventTrace::record(TraceResourceRead, data.size(), 0, QFileInfo(path).fileName());
+
     return data;
 }
 
 QString PalmSystemExtension::getIdentifierForFrame(const QJsonArray &params)
 {
-    qDebug() << __PRETTY_FUNCTION__ << params;
-
     if (params.count() != 2 || !params.at(0).isString() || !params.at(0).isString())
         return QString("");
 
@@ -263,19 +355,75 @@ QString PalmSystemExtension::addBannerMessage(const QJsonArray &params)
 
     notificationParams.insert("hints", hints);
 
-    QJsonDocument document(notificationParams);
+    int bannerId = mNextBannerId++;
+    mPendingBanners.insert(bannerId);
+
+    // The page gets our id right away instead of waiting for the service
+    LSHandle *handle = mLunaPubHandle.get();
+    QByteArray payload = QJsonDocument(notificationParams).toJson();
+    QByteArray callerId = appId.toUtf8();
+    int receiver = mReceiverId;
+
+    LunaServiceThread::instance()->schedule([=]() {
+        LSError lserror;
+        LSErrorInit(&lserror);
+
+        // freed by the callback
+        BannerRequest *request = new BannerRequest;
+        request->receiver = receiver;
+        request->extension = this;
+        request->bannerId = bannerId;
+
+        if (!LSCallFromApplicationOneReply(handle, "luna://org.webosports.notifications/createNotification",
+                                           payload.constData(), callerId.constData(),
+                                           createNotificationCallback, request, 0, &lserror)) {
+            LSErrorPrint(&lserror, stderr);
+            LSErrorFree(&lserror);
+            delete request;
+        }
+    });
+
+    return QString::number(bannerId);
+}
+
+bool PalmSystemExtension::createNotificationCallback(LSHandle *handle, LSMessage *message, void *context)
+{
+    BannerRequest *request = static_cast<BannerRequest*>(context);
 
-    LS::Call call = mLunaPubHandle.callOneReply("luna://org.webosports.notifications/createNotification",
-                                                document.toJson().constData(),
-                                                appId.toUtf8().constData());
-    LS::Message message(call.get());
+    // We're on the service thread here, the reply is decoded here as well
+    JsonReader response(QByteArray(LSMessageGetPayload(message)));
+    int notificationId = response.contains("id") ? response.intValue("id") : -1;
 
-    QJsonObject response = QJsonDocument::fromJson(message.getPayload()).object();
+    PalmSystemExtension *extension = request->extension;
+    int bannerId = request->bannerId;
 
-    if (!response.contains("id"))
-        return QString("");
+    // dropped when the extension is gone meanwhile
+    LunaServiceThread::instance()->post(request->receiver, [=]() {
+        extension->bannerCreated(bannerId, notificationId);
+    });
+
+    delete request;
+    return true;
+}
+
+void PalmSystemExtension::bannerCreated(int bannerId, int notificationId)
+{
+    // The page removed the banner before we knew what to close
+    if (!mPendingBanners.remove(bannerId)) {
+        if (notificationId >= 0) {
+            QJsonObject params;
+            params.insert("id", notificationId);
+            callNotifications("closeNotification", params);
+        }
+        return;
+    }
+
+    if (notificationId < 0) {
+        qWarning() << "Failed to create banner message" << bannerId;
+        return;
+    }
 
-    return QString("%1").arg(response.value("id").toInt());
+    mBannerNotifications.insert(bannerId, notificationId);
 }
 
 
@@ -18,6 +18,9 @@
 #ifndef PALMSYSTEMPLUGIN_H
 #define PALMSYSTEMPLUGIN_H
 
+#include <QMap>
+#include <QSet>
+
 #include <baseextension.h>
 #include <luna-service2++/handle.hpp>
 
@@ -30,7 +33,37 @@ class PalmSystemExtension : public BaseExtension
 {
     Q_OBJECT
 public:
+    enum Property {
+        UnknownProperty,
+        LaunchParamsProperty,
+        HasAlphaHoleProperty,
+        LocaleProperty,
+        LocaleRegionProperty,
+        TimeFormatProperty,
+        TimeZoneProperty,
+        IsMinimalProperty,
+        IdentifierProperty,
+        OrientationProperty,
+        DeviceInfoProperty,
+        IsActivatedProperty,
+        ActivityIdProperty,
+        PhoneRegionProperty,
+        VersionProperty
+    };
+
+    enum SynchronousFunction {
+        UnknownFunction,
+        GetResourceFunction,
+        GetIdentifierForFrameFunction,
+        GetPropertyFunction,
+        AddBannerMessageFunction
+    };
+
+    static Property propertyFromName(const QString &name);
+    static SynchronousFunction synchronousFunctionFromName(const QString &name);
+
     explicit PalmSystemExtension(WebApplicationWindow *applicationWindow, QObject *parent = 0);
+    ~PalmSystemExtension();
 
     QString handleSynchronousCall(const QString& funcName, const QJsonArray& params);
 
@@ -104,7 +137,17 @@ private:
     QString getActivityId(const QJsonArray& params);
     QString addBannerMessage(const QJsonArray& params);
 
+    void callNotifications(const char *method, const QJsonObject &params);
+    void bannerCreated(int bannerId, int notificationId);
+    static bool createNotificationCallback(LSHandle *handle, LSMessage *message, void *context);
+
     LS::Handle mLunaPubHandle;
+    int mReceiverId;
+    // Banners get their id from us right away, the one of the notification
+    // service is only known once it replied
+    int mNextBannerId;
+    QMap<int, int> mBannerNotifications;
+    QSet<int> mPendingBanners;
 };
 
 } // namespace luna
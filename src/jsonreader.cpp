@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QJsonObject>
+
+#include <string.h>
+
+#include "jsonreader.h"
+
+namespace luna
+{
+
+JsonReader::JsonReader(const QByteArray &data) :
+    mData(data),
+    mRoot(jinvalid())
+{
+    if (mData.isEmpty())
+        return;
+
+    JSchemaInfo schemaInfo;
+    jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+    mRoot = jdom_parse(j_str_to_buffer(mData.constData(), mData.size()),
+                       DOMOPT_INPUT_OUTLIVES_WITH_NOCHANGE, &schemaInfo);
+}
+
+JsonReader::~JsonReader()
+{
+    j_release(&mRoot);
+}
+
+bool JsonReader::isObject() const
+{
+    return jis_object(mRoot);
+}
+
+jvalue_ref JsonReader::value(const char *key) const
+{
+    jvalue_ref result = jinvalid();
+
+    if (!jis_object(mRoot))
+        return result;
+
+    if (!jobject_get_exists(mRoot, j_str_to_buffer(key, strlen(key)), &result))
+        return jinvalid();
+
+    return result;
+}
+
+bool JsonReader::contains(const char *key) const
+{
+    jvalue_ref result;
+
+    if (!jis_object(mRoot))
+        return false;
+
+    return jobject_get_exists(mRoot, j_str_to_buffer(key, strlen(key)), &result);
+}
+
+bool JsonReader::isString(const char *key) const
+{
+    return jis_string(value(key));
+}
+
+bool JsonReader::isBool(const char *key) const
+{
+    return jis_boolean(value(key));
+}
+
+bool JsonReader::isNumber(const char *key) const
+{
+    return jis_number(value(key));
+}
+
+bool JsonReader::isArray(const char *key) const
+{
+    return jis_array(value(key));
+}
+
+bool JsonReader::isObject(const char *key) const
+{
+    return jis_object(value(key));
+}
+
+QString JsonReader::stringValue(const char *key, const QString &defaultValue) const
+{
+    jvalue_ref string = value(key);
+    if (!jis_string(string))
+        return defaultValue;
+
+    raw_buffer buffer = jstring_get_fast(string);
+    return QString::fromUtf8(buffer.m_str, buffer.m_len);
+}
+
+bool JsonReader::boolValue(const char *key, bool defaultValue) const
+{
+    jvalue_ref boolean = value(key);
+    if (!jis_boolean(boolean))
+        return defaultValue;
+
+    bool result = defaultValue;
+    jboolean_get(boolean, &result);
+    return result;
+}
+
+int JsonReader::intValue(const char *key, int defaultValue) const
+{
+    jvalue_ref number = value(key);
+    if (!jis_number(number))
+        return defaultValue;
+
+    int32_t result = defaultValue;
+    if (jnumber_get_i32(number, &result) != CONV_OK)
+        return defaultValue;
+
+    return result;
+}
+
+QStringList JsonReader::stringListValue(const char *key) const
+{
+    QStringList result;
+
+    jvalue_ref array = value(key);
+    if (!jis_array(array))
+        return result;
+
+    for (ssize_t n = 0; n < jarray_size(array); n++) {
+        jvalue_ref item = jarray_get(array, n);
+        if (!jis_string(item))
+            continue;
+
+        raw_buffer buffer = jstring_get_fast(item);
+        result.append(QString::fromUtf8(buffer.m_str, buffer.m_len));
+    }
+
+    return result;
+}
+
+QByteArray JsonReader::rawValue(const char *key) const
+{
+    jvalue_ref raw;
+
+    if (!jis_object(mRoot) || !jobject_get_exists(mRoot, j_str_to_buffer(key, strlen(key)), &raw))
+        return QByteArray();
+
+    return QByteArray(jvalue_tostring_simple(raw));
+}
+
+static QJsonValue toJsonValue(jvalue_ref value)
+{
+    if (jis_string(value)) {
+        raw_buffer buffer = jstring_get_fast(value);
+        return QJsonValue(QString::fromUtf8(buffer.m_str, buffer.m_len));
+    }
+
+    if (jis_number(value)) {
+        double number = 0;
+        jnumber_get_f64(value, &number);
+        return QJsonValue(number);
+    }
+
+    if (jis_boolean(value)) {
+        bool boolean = false;
+        jboolean_get(value, &boolean);
+        return QJsonValue(boolean);
+    }
+
+    if (jis_array(value)) {
+        QJsonArray array;
+        for (ssize_t n = 0; n < jarray_size(value); n++)
+            array.append(toJsonValue(jarray_get(value, n)));
+        return array;
+    }
+
+    if (jis_object(value)) {
+        QJsonObject object;
+        jobject_iter iter;
+        jobject_key_value pair;
+
+        jobject_iter_init(&iter, value);
+        while (jobject_iter_next(&iter, &pair)) {
+            raw_buffer key = jstring_get_fast(pair.key);
+            object.insert(QString::fromUtf8(key.m_str, key.m_len), toJsonValue(pair.value));
+        }
+        return object;
+    }
+
+    return QJsonValue(QJsonValue::Null);
+}
+
+QJsonArray JsonReader::arrayValue(const char *key) const
+{
+    jvalue_ref array = value(key);
+    if (!jis_array(array))
+        return QJsonArray();
+
+    // Converted straight from the pbnjson DOM; going through a serialized
+    // copy and QJsonDocument would parse the array a second time
+    return toJsonValue(array).toArray();
+}
+
+} // namespace luna
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef JSONREADER_H
+#define JSONREADER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QJsonArray>
+
+#include <pbnjson.h>
+
+namespace luna
+{
+
+/**
+ * Read-only access to the top level fields of a JSON object. The whole
+ * document is parsed into a pbnjson DOM up front, but its strings reference
+ * the input buffer instead of being copied. Values are only converted to Qt
+ * types when a field is actually read.
+ */
+class JsonReader
+{
+public:
+    explicit JsonReader(const QByteArray &data);
+    ~JsonReader();
+
+    bool isObject() const;
+
+    bool contains(const char *key) const;
+    bool isString(const char *key) const;
+    bool isBool(const char *key) const;
+    bool isNumber(const char *key) const;
+    bool isArray(const char *key) const;
+    bool isObject(const char *key) const;
+
+    QString stringValue(const char *key, const QString &defaultValue = QString()) const;
+    bool boolValue(const char *key, bool defaultValue = false) const;
+    int intValue(const char *key, int defaultValue = 0) const;
+    QStringList stringListValue(const char *key) const;
+    QJsonArray arrayValue(const char *key) const;
+    QByteArray rawValue(const char *key) const;
+
+private:
+    // pbnjson references the input buffer, it has to outlive the DOM
+    QByteArray mData;
+    jvalue_ref mRoot;
+
+    jvalue_ref value(const char *key) const;
+
+    Q_DISABLE_COPY(JsonReader)
+};
+
+} // namespace luna
+
+#endif // JSONREADER_H
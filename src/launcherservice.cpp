@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QDebug>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <glib.h>
+
+#include "launcherservice.h"
+#include "lunaservicethread.h"
+#include "bridgestatistics.h"
+#include "memoryaccounting.h"
+
+namespace luna
+{
+
+static LSMethod serviceMethods[] = {
+    { "getBridgeStatistics", LauncherService::getBridgeStatistics },
+    { "resetBridgeStatistics", LauncherService::resetBridgeStatistics },
+    { "getMemoryUsage", LauncherService::getMemoryUsage },
+    { 0, 0 }
+};
+
+LauncherService::LauncherService(const QString &appId) :
+    mHandle(0),
+    mName(QString("org.webosports.webapp-%1").arg(appId))
+{
+    setup();
+}
+
+LauncherService::~LauncherService()
+{
+    if (!mHandle)
+        return;
+
+    LSError lserror;
+    LSErrorInit(&lserror);
+
+    if (!LSUnregister(mHandle, &lserror)) {
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
+    }
+}
+
+void LauncherService::setup()
+{
+    LSError lserror;
+    LSErrorInit(&lserror);
+
+    if (!LSRegister(mName.toUtf8().constData(), &mHandle, &lserror)) {
+        qWarning() << "Failed to register launcher service" << mName;
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
+        mHandle = 0;
+        return;
+    }
+
+    if (!LSRegisterCategory(mHandle, "/", serviceMethods, NULL, NULL, &lserror)) {
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
+        return;
+    }
+
+    if (!LSCategorySetData(mHandle, "/", this, &lserror)) {
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
+        return;
+    }
+
+    GMainLoop *mainloop = g_main_loop_new(LunaServiceThread::instance()->context(), TRUE);
+    if (!LSGmainAttach(mHandle, mainloop, &lserror)) {
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
+        return;
+    }
+}
+
+bool LauncherService::reply(LSHandle *handle, LSMessage *message, const QByteArray &payload)
+{
+    LSError lserror;
+    LSErrorInit(&lserror);
+
+    if (!LSMessageReply(handle, message, payload.constData(), &lserror)) {
+        LSErrorPrint(&lserror, stderr);
+        LSErrorFree(&lserror);
+    }
+
+    return true;
+}
+
+bool LauncherService::getBridgeStatistics(LSHandle *handle, LSMessage *message, void *user_data)
+{
+    Q_UNUSED(user_data);
+
+    QJsonObject response = BridgeStatistics::instance()->toJson();
+    response.insert("returnValue", true);
+
+    return reply(handle, message, QJsonDocument(response).toJson(QJsonDocument::Compact));
+}
+
+bool LauncherService::resetBridgeStatistics(LSHandle *handle, LSMessage *message, void *user_data)
+{
+    Q_UNUSED(user_data);
+
+    BridgeStatistics::instance()->reset();
+
+    return reply(handle, message, QByteArray("{\"returnValue\":true}"));
+}
+
+/**
+ * Replies with the last memory sample of the application; samples are taken
+ * once a minute on the GUI thread.
+ */
+bool LauncherService::getMemoryUsage(LSHandle *handle, LSMessage *message, void *user_data)
+{
+    Q_UNUSED(user_data);
+
+    QJsonObject response = MemoryAccounting::lastSample();
+    if (response.isEmpty())
+        return reply(handle, message, QByteArray("{\"returnValue\":false,\"errorText\":\"No sample taken yet\"}"));
+
+    response.insert("returnValue", true);
+
+    return reply(handle, message, QJsonDocument(response).toJson(QJsonDocument::Compact));
+}
+
+} // namespace luna
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef LAUNCHERSERVICE_H
+#define LAUNCHERSERVICE_H
+
+#include <QString>
+#include <luna-service2/lunaservice.h>
+
+namespace luna
+{
+
+/**
+ * The launcher's own service on the bus, registered as
+ * org.webosports.webapp-<appid>. It serves introspection data of the running
+ * launcher process. Methods are handled on the luna service thread.
+ */
+class LauncherService
+{
+public:
+    explicit LauncherService(const QString &appId);
+    ~LauncherService();
+
+    static bool getBridgeStatistics(LSHandle *handle, LSMessage *message, void *user_data);
+    static bool resetBridgeStatistics(LSHandle *handle, LSMessage *message, void *user_data);
+    static bool getMemoryUsage(LSHandle *handle, LSMessage *message, void *user_data);
+
+private:
+    void setup();
+    static bool reply(LSHandle *handle, LSMessage *message, const QByteArray &payload);
+
+    LSHandle *mHandle;
+    QString mName;
+};
+
+} // namespace luna
+
+#endif // LAUNCHERSERVICE_H
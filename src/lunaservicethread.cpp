@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QTimer>
+
+#include "lunaservicethread.h"
+
+// Time we're allowed to spend per frame on the GUI thread for handing out
+// replies. Everything left over is handled with the next frame.
+#define DRAIN_BUDGET_MS     4
+#define FRAME_INTERVAL_MS   16
+
+namespace luna
+{
+
+LunaServiceThread* LunaServiceThread::instance()
+{
+    static LunaServiceThread* instance = 0;
+
+    if (!instance) {
+        instance = new LunaServiceThread();
+        instance->start();
+    }
+
+    return instance;
+}
+
+LunaServiceThread::LunaServiceThread() :
+    mContext(g_main_context_new()),
+    mLoop(0),
+    mHead(&mStub),
+    mTail(&mStub),
+    mDrainScheduled(false),
+    mNextReceiver(1)
+{
+    mStub.next.store(0);
+    mLoop = g_main_loop_new(mContext, FALSE);
+}
+
+LunaServiceThread::~LunaServiceThread()
+{
+    g_main_loop_quit(mLoop);
+    wait();
+
+    while (Item *item = pop())
+        delete item;
+
+    g_main_loop_unref(mLoop);
+    g_main_context_unref(mContext);
+}
+
+GMainContext* LunaServiceThread::context() const
+{
+    return mContext;
+}
+
+void LunaServiceThread::run()
+{
+    g_main_context_push_thread_default(mContext);
+    g_main_loop_run(mLoop);
+    g_main_context_pop_thread_default(mContext);
+}
+
+int LunaServiceThread::registerReceiver()
+{
+    int receiver = mNextReceiver++;
+    mReceivers.insert(receiver);
+    return receiver;
+}
+
+void LunaServiceThread::unregisterReceiver(int receiver)
+{
+    // Anything still queued for the receiver is dropped when being drained
+    mReceivers.remove(receiver);
+}
+
+/**
+ * Queues a handler to be executed on the GUI thread. Safe to call from any
+ * thread. The handler is only executed if the receiver is still registered
+ * at that point.
+ */
+void LunaServiceThread::post(int receiver, const std::function<void()>& handler)
+{
+    Item *item = new Item;
+    item->receiver = receiver;
+    item->handler = handler;
+
+    push(item);
+
+    if (!mDrainScheduled.exchange(true))
+        QMetaObject::invokeMethod(this, "drain", Qt::QueuedConnection);
+}
+
+/**
+ * Queues the function to be run on the service thread and returns right
+ * away. Functions run in the order they were scheduled in. Runs it directly
+ * when called on the service thread itself or once the thread is gone.
+ */
+void LunaServiceThread::schedule(const std::function<void()>& function)
+{
+    if (QThread::currentThread() == this || !isRunning()) {
+        function();
+        return;
+    }
+
+    g_main_context_invoke_full(mContext, G_PRIORITY_DEFAULT, &LunaServiceThread::runScheduled,
+                               new std::function<void()>(function), &LunaServiceThread::freeScheduled);
+}
+
+gboolean LunaServiceThread::runScheduled(gpointer data)
+{
+    (*static_cast<std::function<void()>*>(data))();
+    return FALSE;
+}
+
+void LunaServiceThread::freeScheduled(gpointer data)
+{
+    delete static_cast<std::function<void()>*>(data);
+}
+
+void LunaServiceThread::push(Item *item)
+{
+    item->next.store(0, std::memory_order_relaxed);
+    Item *prev = mHead.exchange(item, std::memory_order_acq_rel);
+    prev->next.store(item, std::memory_order_release);
+}
+
+LunaServiceThread::Item* LunaServiceThread::pop()
+{
+    Item *tail = mTail;
+    Item *next = tail->next.load(std::memory_order_acquire);
+
+    if (tail == &mStub) {
+        if (!next)
+            return 0;
+
+        mTail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next) {
+        mTail = next;
+        return tail;
+    }
+
+    // A producer is in the middle of pushing; it will schedule another drain
+    if (tail != mHead.load(std::memory_order_acquire))
+        return 0;
+
+    push(&mStub);
+
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+        mTail = next;
+        return tail;
+    }
+
+    return 0;
+}
+
+void LunaServiceThread::drain()
+{
+    mDrainScheduled.store(false);
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    while (Item *item = pop()) {
+        if (mReceivers.contains(item->receiver))
+            item->handler();
+
+        delete item;
+
+        if (elapsed.elapsed() >= DRAIN_BUDGET_MS) {
+            if (!mDrainScheduled.exchange(true))
+                QTimer::singleShot(FRAME_INTERVAL_MS, this, SLOT(drain()));
+            return;
+        }
+    }
+}
+
+} // namespace luna
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef LUNASERVICETHREAD_H
+#define LUNASERVICETHREAD_H
+
+#include <QThread>
+#include <QSet>
+
+#include <atomic>
+#include <functional>
+
+#include <glib.h>
+
+namespace luna
+{
+
+/**
+ * Runs all luna bus I/O on a separate thread with its own GMainContext so
+ * bursts of bus traffic don't compete with rendering and input handling on
+ * the GUI thread. Reply handlers decode their payload on this thread and hand
+ * the result over with post() which queues it without taking any lock. The
+ * queue is drained on the GUI thread with a fixed time budget per frame.
+ * Handles attached to our context are only used from this thread, calls on
+ * them are handed over with schedule() which never waits for them. Results
+ * come back through post() like replies do.
+ */
+class LunaServiceThread : public QThread
+{
+    Q_OBJECT
+public:
+    static LunaServiceThread* instance();
+    ~LunaServiceThread();
+
+    GMainContext* context() const;
+
+    int registerReceiver();
+    void unregisterReceiver(int receiver);
+
+    void post(int receiver, const std::function<void()>& handler);
+    void schedule(const std::function<void()>& function);
+
+protected:
+    void run();
+
+private Q_SLOTS:
+    void drain();
+
+private:
+    struct Item
+    {
+        std::atomic<Item*> next;
+        int receiver;
+        std::function<void()> handler;
+    };
+
+    LunaServiceThread();
+
+    static gboolean runScheduled(gpointer data);
+    static void freeScheduled(gpointer data);
+
+    void push(Item *item);
+    Item* pop();
+
+    GMainContext *mContext;
+    GMainLoop *mLoop;
+
+    // intrusive multiple producer/single consumer queue, consumed on the GUI thread
+    std::atomic<Item*> mHead;
+    Item *mTail;
+    Item mStub;
+    std::atomic<bool> mDrainScheduled;
+
+    QSet<int> mReceivers;
+    int mNextReceiver;
+};
+
+} // namespace luna
+
+#endif // LUNASERVICETHREAD_H
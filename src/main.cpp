@@ -35,6 +35,7 @@ static gchar *option_parameters = NULL;
 static gboolean option_debug = FALSE;
 static gboolean option_version = FALSE;
 static gboolean option_verbose = FALSE;
+static gboolean option_lightweight_headless = FALSE;
 
 static GOptionEntry options[] = {
     { "appinfo", 'a', 0, G_OPTION_ARG_STRING, &option_appinfo,
@@ -45,6 +46,8 @@ static GOptionEntry options[] = {
         "Enable debugging modus. This will start the webkit inspector "
         "on http://localhost:1122/" },
     { "verbose", 0, 0, G_OPTION_ARG_NONE, &option_verbose, "Enable verbose logging" },
+    { "lightweight-headless", 0, 0, G_OPTION_ARG_NONE, &option_lightweight_headless,
+        "Run the background page of headless applications in a reduced container" },
     { "version", 'v', 0, G_OPTION_ARG_NONE, &option_version,
         "Show version information and exit" },
     { NULL },
@@ -139,6 +142,8 @@ int main(int argc, char **argv)
 
     luna::SystemTime::instance();
 
+    webAppLauncher.setLightweightHeadless(option_lightweight_headless);
+
     webAppLauncher.launchApp(option_appinfo, option_parameters);
 
 cleanup:
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QDebug>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+
+#include <unistd.h>
+
+#include "memoryaccounting.h"
+#include "webapplication.h"
+#include "webapplicationwindow.h"
+
+#define SAMPLE_INTERVAL_MS  60000
+
+namespace luna
+{
+
+static QMutex lastSampleMutex;
+static QJsonObject lastMemorySample;
+
+static QJsonObject processMemoryToJson(const MemoryAccounting::ProcessMemory &memory)
+{
+    QJsonObject object;
+    object.insert("rss", (double) memory.rss);
+    object.insert("pss", (double) memory.pss);
+    object.insert("swap", (double) memory.swap);
+    return object;
+}
+
+MemoryAccounting::MemoryAccounting(WebApplication *application, QObject *parent) :
+    QObject(parent),
+    mApplication(application)
+{
+    mSampleTimer.setInterval(SAMPLE_INTERVAL_MS);
+    connect(&mSampleTimer, SIGNAL(timeout()), this, SLOT(onSampleTimeout()));
+}
+
+void MemoryAccounting::start()
+{
+    mSampleTimer.start();
+}
+
+/**
+ * Stops the periodic samples, e.g. while the application is suspended.
+ * Samples can still be taken on demand.
+ */
+void MemoryAccounting::stop()
+{
+    mSampleTimer.stop();
+}
+
+void MemoryAccounting::onSampleTimeout()
+{
+    QJsonObject usage = sample();
+
+    qDebug() << "Memory of app" << mApplication->id() << "launcher"
+             << usage.value("launcher").toObject().value("pss").toDouble() << "kB PSS, web processes"
+             << usage.value("webProcesses").toObject().value("pss").toDouble() << "kB PSS, QML heaps"
+             << usage.value("qmlHeapUsed").toDouble() << "kB," << usage.value("windows").toArray().count()
+             << "windows";
+}
+
+/**
+ * Takes a sample of the memory used by the application. All sizes are in
+ * kB. Web processes shared between windows are only counted once.
+ */
+QJsonObject MemoryAccounting::sample()
+{
+    QJsonArray windows;
+    QSet<qint64> webProcessesSeen;
+    ProcessMemory webProcesses;
+    webProcesses.rss = webProcesses.pss = webProcesses.swap = 0;
+    double qmlHeapUsed = 0;
+
+    Q_FOREACH(WebApplicationWindow *window, mApplication->windows()) {
+        QJsonObject usage = window->memoryUsage();
+        windows.append(usage);
+
+        qmlHeapUsed += usage.value("qmlHeapUsed").toDouble();
+
+        QJsonObject webProcess = usage.value("webProcess").toObject();
+        qint64 pid = webProcess.value("pid").toDouble();
+        if (pid <= 0 || webProcessesSeen.contains(pid) || webProcess.value("rss").toDouble() < 0)
+            continue;
+
+        webProcessesSeen.insert(pid);
+        webProcesses.rss += webProcess.value("rss").toDouble();
+        webProcesses.pss += webProcess.value("pss").toDouble();
+        webProcesses.swap += webProcess.value("swap").toDouble();
+    }
+
+    QJsonObject webProcessesTotal = processMemoryToJson(webProcesses);
+    webProcessesTotal.insert("count", webProcessesSeen.count());
+
+    QJsonObject usage;
+    usage.insert("appId", mApplication->id());
+    usage.insert("sampledAt", (double) QDateTime::currentMSecsSinceEpoch());
+    usage.insert("launcher", processMemoryToJson(processMemory(getpid())));
+    usage.insert("webProcesses", webProcessesTotal);
+    usage.insert("qmlHeapUsed", qmlHeapUsed);
+    usage.insert("windows", windows);
+
+    QMutexLocker locker(&lastSampleMutex);
+    lastMemorySample = usage;
+
+    return usage;
+}
+
+/**
+ * The last sample taken, safe to call from any thread.
+ */
+QJsonObject MemoryAccounting::lastSample()
+{
+    QMutexLocker locker(&lastSampleMutex);
+    return lastMemorySample;
+}
+
+/**
+ * Reads RSS, PSS and swap of a process. smaps_rollup is only available on
+ * newer kernels, the per mapping smaps is summed up otherwise.
+ */
+MemoryAccounting::ProcessMemory MemoryAccounting::processMemory(qint64 pid)
+{
+    ProcessMemory memory;
+
+    QFile smaps(QString("/proc/%1/smaps_rollup").arg(pid));
+    if (!smaps.open(QIODevice::ReadOnly)) {
+        smaps.setFileName(QString("/proc/%1/smaps").arg(pid));
+        if (!smaps.open(QIODevice::ReadOnly))
+            return memory;
+    }
+
+    memory.rss = memory.pss = memory.swap = 0;
+
+    QList<QByteArray> lines = smaps.readAll().split('\n');
+    Q_FOREACH(const QByteArray &line, lines) {
+        qint64 *field = 0;
+        if (line.startsWith("Rss:"))
+            field = &memory.rss;
+        else if (line.startsWith("Pss:"))
+            field = &memory.pss;
+        else if (line.startsWith("Swap:"))
+            field = &memory.swap;
+        else
+            continue;
+
+        QList<QByteArray> parts = line.simplified().split(' ');
+        if (parts.count() >= 2)
+            *field += parts.at(1).toLongLong();
+    }
+
+    return memory;
+}
+
+} // namespace luna
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef MEMORYACCOUNTING_H
+#define MEMORYACCOUNTING_H
+
+#include <QObject>
+#include <QJsonObject>
+#include <QTimer>
+
+namespace luna
+{
+
+class WebApplication;
+
+/**
+ * Samples the memory used by an application: the launcher process itself,
+ * the web processes of its windows and what each window reports about its
+ * QML engine. Samples are taken periodically on the GUI
+ * thread; the last one can be read from any thread.
+ */
+class MemoryAccounting : public QObject
+{
+    Q_OBJECT
+public:
+    struct ProcessMemory
+    {
+        ProcessMemory() : rss(-1), pss(-1), swap(-1) { }
+
+        bool isValid() const { return rss >= 0; }
+
+        // all in kB, -1 if unknown
+        qint64 rss;
+        qint64 pss;
+        qint64 swap;
+    };
+
+    explicit MemoryAccounting(WebApplication *application, QObject *parent = 0);
+
+    void start();
+    void stop();
+
+    QJsonObject sample();
+    static QJsonObject lastSample();
+
+    // The one place memory of a process is read from, for us and others
+    static ProcessMemory processMemory(qint64 pid);
+
+private Q_SLOTS:
+    void onSampleTimeout();
+
+private:
+    WebApplication *mApplication;
+    QTimer mSampleTimer;
+};
+
+} // namespace luna
+
+#endif // MEMORYACCOUNTING_H
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QDebug>
+#include <QFile>
+#include <QSocketNotifier>
+#include <QStringList>
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "memorypressuremonitor.h"
+
+// Report when tasks were stalled on memory for at least 300ms within 2s;
+// unprivileged processes may only use windows which are a multiple of 2s
+#define PSI_TRIGGER "some 300000 2000000"
+
+namespace luna
+{
+
+MemoryPressureMonitor::MemoryPressureMonitor(QObject *parent) :
+    QObject(parent),
+    mFd(-1),
+    mNotifier(0)
+{
+}
+
+MemoryPressureMonitor::~MemoryPressureMonitor()
+{
+    delete mNotifier;
+
+    if (mFd >= 0)
+        close(mFd);
+}
+
+QString MemoryPressureMonitor::pressureFilePath() const
+{
+    QFile cgroupFile("/proc/self/cgroup");
+    if (cgroupFile.open(QIODevice::ReadOnly)) {
+        // cgroup v2 entries look like "0::/path/of/our/cgroup"
+        Q_FOREACH(const QByteArray &line, cgroupFile.readAll().split('\n')) {
+            if (!line.startsWith("0::"))
+                continue;
+
+            QString path = QString("/sys/fs/cgroup%1/memory.pressure").arg(QString(line.mid(3)));
+            if (QFile::exists(path))
+                return path;
+        }
+    }
+
+    return QString("/proc/pressure/memory");
+}
+
+bool MemoryPressureMonitor::start()
+{
+    if (mFd >= 0)
+        return true;
+
+    QString path = pressureFilePath();
+
+    mFd = open(path.toUtf8().constData(), O_RDWR | O_NONBLOCK);
+    if (mFd < 0) {
+        qWarning() << "Memory pressure information is not available at" << path;
+        return false;
+    }
+
+    if (write(mFd, PSI_TRIGGER, strlen(PSI_TRIGGER) + 1) < 0) {
+        qWarning() << "Failed to setup memory pressure trigger for" << path;
+        close(mFd);
+        mFd = -1;
+        return false;
+    }
+
+    // PSI triggers are signaled as POLLPRI which maps to the exception type
+    mNotifier = new QSocketNotifier(mFd, QSocketNotifier::Exception, this);
+    connect(mNotifier, SIGNAL(activated(int)), this, SLOT(onPressureEvent()));
+
+    qDebug() << "Watching memory pressure through" << path;
+
+    return true;
+}
+
+void MemoryPressureMonitor::onPressureEvent()
+{
+    emit pressureDetected();
+}
+
+} // namespace luna
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef MEMORYPRESSUREMONITOR_H
+#define MEMORYPRESSUREMONITOR_H
+
+#include <QObject>
+#include <QString>
+
+class QSocketNotifier;
+
+namespace luna
+{
+
+/**
+ * Watches the kernel's pressure stall information (PSI) for memory and emits
+ * pressureDetected() whenever the configured stall threshold is exceeded.
+ * The cgroup v2 memory.pressure file of our own cgroup is preferred over the
+ * system wide /proc/pressure/memory one.
+ */
+class MemoryPressureMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MemoryPressureMonitor(QObject *parent = 0);
+    ~MemoryPressureMonitor();
+
+    bool start();
+
+Q_SIGNALS:
+    void pressureDetected();
+
+private Q_SLOTS:
+    void onPressureEvent();
+
+private:
+    int mFd;
+    QSocketNotifier *mNotifier;
+
+    QString pressureFilePath() const;
+};
+
+} // namespace luna
+
+#endif // MEMORYPRESSUREMONITOR_H
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QDebug>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusServiceWatcher>
+#include <QDBusVariant>
+#include <QVariantMap>
+
+#include "networkstate.h"
+
+#define CONNMAN_SERVICE         "net.connman"
+#define CONNMAN_MANAGER_PATH    "/"
+#define CONNMAN_MANAGER_IFACE   "net.connman.Manager"
+
+#define ONLINE_DEBOUNCE_INTERVAL 2000
+
+namespace luna
+{
+
+NetworkState* NetworkState::instance()
+{
+    static NetworkState* instance = 0;
+
+    if (!instance)
+        instance = new NetworkState();
+
+    return instance;
+}
+
+NetworkState::NetworkState() :
+    mState("unknown"),
+    mWasOffline(false),
+    mServiceWatcher(0)
+{
+    mOnlineDebounceTimer.setSingleShot(true);
+    mOnlineDebounceTimer.setInterval(ONLINE_DEBOUNCE_INTERVAL);
+    connect(&mOnlineDebounceTimer, SIGNAL(timeout()), this, SLOT(onOnlineDebounceTimeout()));
+
+    QDBusConnection bus = QDBusConnection::systemBus();
+
+    mServiceWatcher = new QDBusServiceWatcher(CONNMAN_SERVICE, bus,
+                                              QDBusServiceWatcher::WatchForOwnerChange, this);
+    connect(mServiceWatcher, SIGNAL(serviceRegistered(QString)), this, SLOT(onConnmanRegistered()));
+    connect(mServiceWatcher, SIGNAL(serviceUnregistered(QString)), this, SLOT(onConnmanUnregistered()));
+
+    bus.connect(CONNMAN_SERVICE, CONNMAN_MANAGER_PATH, CONNMAN_MANAGER_IFACE, "PropertyChanged",
+                this, SLOT(onPropertyChanged(QString,QDBusVariant)));
+
+    queryProperties();
+}
+
+NetworkState::~NetworkState()
+{
+}
+
+QString NetworkState::state() const
+{
+    return mState;
+}
+
+bool NetworkState::online() const
+{
+    return mState == "online";
+}
+
+/**
+ * Whether connman reported a state without internet connectivity. False as
+ * long as the state is not known yet.
+ */
+bool NetworkState::offline() const
+{
+    return mState != "unknown" && !online();
+}
+
+void NetworkState::queryProperties()
+{
+    QDBusMessage message = QDBusMessage::createMethodCall(CONNMAN_SERVICE, CONNMAN_MANAGER_PATH,
+                                                          CONNMAN_MANAGER_IFACE, "GetProperties");
+
+    QDBusPendingCall call = QDBusConnection::systemBus().asyncCall(message);
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onPropertiesReceived(QDBusPendingCallWatcher*)));
+}
+
+void NetworkState::onPropertiesReceived(QDBusPendingCallWatcher *watcher)
+{
+    QDBusPendingReply<QVariantMap> reply = *watcher;
+    watcher->deleteLater();
+
+    if (reply.isError()) {
+        qWarning() << "Failed to query connman state:" << reply.error().message();
+        return;
+    }
+
+    setState(reply.value().value("State").toString());
+}
+
+void NetworkState::onPropertyChanged(const QString &name, const QDBusVariant &value)
+{
+    if (name != "State")
+        return;
+
+    setState(value.variant().toString());
+}
+
+void NetworkState::onConnmanRegistered()
+{
+    queryProperties();
+}
+
+void NetworkState::onConnmanUnregistered()
+{
+    setState("unknown");
+}
+
+void NetworkState::setState(const QString &state)
+{
+    if (mState == state)
+        return;
+
+    bool wasOnline = online();
+
+    qDebug() << "Network state changed from" << mState << "to" << state;
+
+    mState = state;
+    emit stateChanged();
+
+    if (offline())
+        mWasOffline = true;
+
+    // The first state connman reports is no transition to tell anyone about
+    if (online() && !wasOnline && mWasOffline)
+        mOnlineDebounceTimer.start();
+    else if (!online())
+        mOnlineDebounceTimer.stop();
+}
+
+void NetworkState::onOnlineDebounceTimeout()
+{
+    mWasOffline = false;
+    emit wentOnline();
+}
+
+} // namespace luna
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef NETWORKSTATE_H
+#define NETWORKSTATE_H
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+class QDBusPendingCallWatcher;
+class QDBusServiceWatcher;
+class QDBusVariant;
+
+namespace luna
+{
+
+/**
+ * Tracks the global connman state once per process and shares it between
+ * all windows. The online property follows connman right away while the
+ * wentOnline signal is only emitted once the connection stayed up for a
+ * moment so flapping links don't cause a reload storm. Until connman told
+ * us its state we are neither online nor offline and wentOnline is only
+ * emitted when we really were offline before.
+ */
+class NetworkState : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QString state READ state NOTIFY stateChanged)
+    Q_PROPERTY(bool online READ online NOTIFY stateChanged)
+    Q_PROPERTY(bool offline READ offline NOTIFY stateChanged)
+
+public:
+    static NetworkState* instance();
+    ~NetworkState();
+
+    QString state() const;
+    bool online() const;
+    bool offline() const;
+
+Q_SIGNALS:
+    void stateChanged();
+    void wentOnline();
+
+private Q_SLOTS:
+    void onPropertiesReceived(QDBusPendingCallWatcher *watcher);
+    void onPropertyChanged(const QString &name, const QDBusVariant &value);
+    void onConnmanRegistered();
+    void onConnmanUnregistered();
+    void onOnlineDebounceTimeout();
+
+private:
+    NetworkState();
+
+    void queryProperties();
+    void setState(const QString &state);
+
+    QString mState;
+    bool mWasOffline;
+    QTimer mOnlineDebounceTimer;
+    QDBusServiceWatcher *mServiceWatcher;
+};
+
+} // namespace luna
+
+#endif // NETWORKSTATE_H
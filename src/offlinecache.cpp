@@ -0,0 +1,430 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QDebug>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QRegularExpression>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "offlinecache.h"
+#include "utils.h"
+
+#define OFFLINE_CACHE_APP_BUDGET        (8 * 1024 * 1024)
+#define OFFLINE_CACHE_MAX_RESOURCE_SIZE (2 * 1024 * 1024)
+#define OFFLINE_CACHE_MAX_ENTRY_SIZE    (1024 * 1024)
+
+namespace luna
+{
+
+/**
+ * Builds the cached entry page with every cached resource it references
+ * inlined as data url. Works on a copy of the index so revalidation can go
+ * on meanwhile; resources are replaced by renaming so they are never read
+ * half written.
+ */
+class OfflineDocumentBuilder : public QObject,
+                               public QRunnable
+{
+    Q_OBJECT
+
+public:
+    explicit OfflineDocumentBuilder(const OfflineCache *cache) :
+        mDirectory(cache->mDirectory),
+        mEntryPoint(cache->mEntryPoint),
+        mResources(cache->mResources)
+    {
+    }
+
+    void run()
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        QString document = build();
+
+        qDebug() << "Offline copy of" << mEntryPoint << "prepared in" << timer.elapsed() << "ms";
+
+        emit built(document);
+    }
+
+Q_SIGNALS:
+    void built(const QString &document);
+
+private:
+    QByteArray read(const QString &key) const
+    {
+        if (!mResources.contains(key))
+            return QByteArray();
+
+        QFile file(QString("%1/%2").arg(mDirectory).arg(mResources.value(key).file));
+        if (!file.open(QIODevice::ReadOnly))
+            return QByteArray();
+
+        return file.readAll();
+    }
+
+    QString build() const
+    {
+        QString document = QString::fromUtf8(read(mEntryPoint.toString()));
+        if (document.isEmpty())
+            return QString();
+
+        QList<OfflineCache::Reference> references = OfflineCache::findReferences(mEntryPoint, document);
+
+        // replace from the end so the positions of the remaining references stay valid
+        for (int n = references.count() - 1; n >= 0; n--) {
+            const OfflineCache::Reference &reference = references.at(n);
+            QString key = reference.url.toString();
+
+            QByteArray data = read(key);
+            if (data.isEmpty())
+                continue;
+
+            QString dataUrl = QString("data:%1;base64,%2")
+                    .arg(mResources.value(key).contentType)
+                    .arg(QString::fromLatin1(data.toBase64()));
+
+            document.replace(reference.start, reference.length, dataUrl);
+        }
+
+        return document;
+    }
+
+    QString mDirectory;
+    QUrl mEntryPoint;
+    QHash<QString, OfflineCache::Resource> mResources;
+};
+
+OfflineCache::OfflineCache(const QString &appId, const QUrl &entryPoint, QObject *parent) :
+    QObject(parent),
+    mDirectory(launcherCachePath(QString("offline/%1").arg(appId))),
+    mEntryPoint(entryPoint),
+    mTotalSize(0),
+    mNetworkManager(0),
+    mPendingReplies(0),
+    mRevalidated(false)
+{
+    loadIndex();
+}
+
+OfflineCache::~OfflineCache()
+{
+}
+
+bool OfflineCache::isAvailable() const
+{
+    return mResources.contains(mEntryPoint.toString());
+}
+
+QString OfflineCache::resourcePath(const QString &file) const
+{
+    return QString("%1/%2").arg(mDirectory).arg(file);
+}
+
+QByteArray OfflineCache::readResource(const QString &key) const
+{
+    if (!mResources.contains(key))
+        return QByteArray();
+
+    QFile file(resourcePath(mResources.value(key).file));
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    return file.readAll();
+}
+
+/**
+ * Finds all scripts, images, stylesheets and icons the document references
+ * and returns the position of the attribute value so it can be replaced.
+ * Called from the document builder thread as well.
+ */
+QList<OfflineCache::Reference> OfflineCache::findReferences(const QUrl &entryPoint, const QString &document)
+{
+    // not shared between threads, this runs once per revalidation or offline launch
+    QRegularExpression tagExpression("<(script|img|link)\\b[^>]*>",
+                                     QRegularExpression::CaseInsensitiveOption);
+    QRegularExpression sourceExpression("\\b(?:src|href)\\s*=\\s*[\"']([^\"']+)[\"']",
+                                        QRegularExpression::CaseInsensitiveOption);
+    QRegularExpression relExpression("\\brel\\s*=\\s*[\"'][^\"']*(stylesheet|icon)",
+                                     QRegularExpression::CaseInsensitiveOption);
+
+    QList<Reference> references;
+
+    QRegularExpressionMatchIterator tags = tagExpression.globalMatch(document);
+    while (tags.hasNext()) {
+        QRegularExpressionMatch tag = tags.next();
+        QString tagText = tag.captured(0);
+
+        if (tag.captured(1).toLower() == "link" && !relExpression.match(tagText).hasMatch())
+            continue;
+
+        QRegularExpressionMatch source = sourceExpression.match(tagText);
+        if (!source.hasMatch())
+            continue;
+
+        QUrl url = entryPoint.resolved(QUrl(source.captured(1)));
+        if (url.scheme() != "http" && url.scheme() != "https")
+            continue;
+
+        Reference reference;
+        reference.start = tag.capturedStart(0) + source.capturedStart(1);
+        reference.length = source.capturedLength(1);
+        reference.url = url;
+        references.append(reference);
+    }
+
+    return references;
+}
+
+/**
+ * Builds the self contained offline document on a worker thread and emits
+ * offlineDocumentReady() with it. The document is meant to be loaded with
+ * the entry point as base url so the application keeps its origin.
+ */
+void OfflineCache::prepareOfflineDocument()
+{
+    OfflineDocumentBuilder *builder = new OfflineDocumentBuilder(this);
+    connect(builder, SIGNAL(built(QString)), this, SIGNAL(offlineDocumentReady(QString)));
+
+    QThreadPool::globalInstance()->start(builder);
+}
+
+/**
+ * Revalidates the cached copy once per process. Called after the entry page
+ * was loaded from the network so it doesn't compete with the launch itself.
+ */
+void OfflineCache::revalidate()
+{
+    if (mRevalidated || mPendingReplies > 0)
+        return;
+
+    mRevalidated = true;
+
+    if (!mNetworkManager)
+        mNetworkManager = new QNetworkAccessManager(this);
+
+    QDir().mkpath(mDirectory);
+
+    fetch(mEntryPoint);
+}
+
+void OfflineCache::fetch(const QUrl &url)
+{
+    QNetworkRequest request(url);
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+
+    QString key = url.toString();
+    if (mResources.contains(key) && QFile::exists(resourcePath(mResources.value(key).file))) {
+        const Resource &resource = mResources[key];
+        if (!resource.etag.isEmpty())
+            request.setRawHeader("If-None-Match", resource.etag);
+        if (!resource.lastModified.isEmpty())
+            request.setRawHeader("If-Modified-Since", resource.lastModified);
+    }
+
+    QNetworkReply *reply = mNetworkManager->get(request);
+    connect(reply, SIGNAL(finished()), this, SLOT(onReplyFinished()));
+    mPendingReplies++;
+}
+
+void OfflineCache::onReplyFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply)
+        return;
+
+    reply->deleteLater();
+    mPendingReplies--;
+
+    QString key = reply->request().url().toString();
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    if (reply->error() != QNetworkReply::NoError)
+        qDebug() << "Failed to revalidate" << key << "for the offline cache:" << reply->errorString();
+    else if (status == 200)
+        storeResource(key, reply);
+
+    // the (possibly updated) entry page tells us which subresources to keep
+    if (key == mEntryPoint.toString() && reply->error() == QNetworkReply::NoError)
+        revalidateSubresources();
+
+    if (mPendingReplies == 0) {
+        saveIndex();
+        qDebug() << "Offline cache for" << mEntryPoint << "revalidated:"
+                 << mResources.count() << "resources," << mTotalSize << "bytes";
+        emit revalidated();
+    }
+}
+
+void OfflineCache::storeResource(const QString &key, QNetworkReply *reply)
+{
+    // We fetch without the cookies of the page (they live in the web
+    // process) so never keep what the server marks as personal
+    QByteArray cacheControl = reply->rawHeader("Cache-Control").toLower();
+    if (cacheControl.contains("no-store") || cacheControl.contains("private")) {
+        qDebug() << "Not storing" << key << "in the offline cache, the server doesn't allow it";
+        return;
+    }
+
+    QByteArray data = reply->readAll();
+
+    Resource resource = mResources.value(key);
+    bool isEntryPoint = (key == mEntryPoint.toString());
+
+    // The entry page has its own limit and is always kept, everything else
+    // has to fit into the budget left
+    if (isEntryPoint && data.size() > OFFLINE_CACHE_MAX_ENTRY_SIZE) {
+        qDebug() << "Not storing entry page" << key << "in the offline cache, it's too large";
+        return;
+    }
+
+    if (!isEntryPoint && (data.size() > OFFLINE_CACHE_MAX_RESOURCE_SIZE ||
+                          mTotalSize - resource.size + data.size() > OFFLINE_CACHE_APP_BUDGET)) {
+        qDebug() << "Not storing" << key << "in the offline cache, it doesn't fit into the budget";
+        return;
+    }
+
+    if (resource.file.isEmpty())
+        resource.file = QString::fromLatin1(QCryptographicHash::hash(key.toUtf8(),
+                                                                     QCryptographicHash::Sha1).toHex());
+
+    // Replace the file by renaming so a document builder never reads it half written
+    QString path = resourcePath(resource.file);
+    QFile file(path + ".tmp");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data) != data.size()) {
+        qWarning() << "Failed to write offline cache entry" << path;
+        file.remove();
+        return;
+    }
+
+    file.close();
+    QFile::remove(path);
+    QFile::rename(file.fileName(), path);
+
+    mTotalSize += data.size() - resource.size;
+
+    resource.size = data.size();
+    resource.contentType = reply->header(QNetworkRequest::ContentTypeHeader).toString();
+    resource.etag = reply->rawHeader("ETag");
+    resource.lastModified = reply->rawHeader("Last-Modified");
+
+    mResources.insert(key, resource);
+}
+
+void OfflineCache::revalidateSubresources()
+{
+    QString document = QString::fromUtf8(readResource(mEntryPoint.toString()));
+
+    QSet<QString> referenced;
+    referenced.insert(mEntryPoint.toString());
+
+    Q_FOREACH(const Reference &reference, findReferences(mEntryPoint, document)) {
+        QString key = reference.url.toString();
+        if (referenced.contains(key))
+            continue;
+
+        referenced.insert(key);
+        fetch(reference.url);
+    }
+
+    dropUnreferenced(referenced);
+}
+
+void OfflineCache::dropUnreferenced(const QSet<QString> &referenced)
+{
+    QHash<QString, Resource>::iterator iter = mResources.begin();
+    while (iter != mResources.end()) {
+        if (referenced.contains(iter.key())) {
+            ++iter;
+            continue;
+        }
+
+        QFile::remove(resourcePath(iter.value().file));
+        mTotalSize -= iter.value().size;
+        iter = mResources.erase(iter);
+    }
+}
+
+void OfflineCache::loadIndex()
+{
+    QFile file(resourcePath("index.json"));
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QJsonObject index = QJsonDocument::fromJson(file.readAll()).object();
+
+    QJsonObject::const_iterator iter;
+    for (iter = index.constBegin(); iter != index.constEnd(); ++iter) {
+        QJsonObject entry = iter.value().toObject();
+
+        Resource resource;
+        resource.file = entry.value("file").toString();
+        resource.contentType = entry.value("contentType").toString();
+        resource.etag = entry.value("etag").toString().toLatin1();
+        resource.lastModified = entry.value("lastModified").toString().toLatin1();
+        resource.size = static_cast<qint64>(entry.value("size").toDouble());
+
+        if (resource.file.isEmpty() || !QFile::exists(resourcePath(resource.file)))
+            continue;
+
+        mResources.insert(iter.key(), resource);
+        mTotalSize += resource.size;
+    }
+}
+
+void OfflineCache::saveIndex()
+{
+    QJsonObject index;
+
+    QHash<QString, Resource>::const_iterator iter;
+    for (iter = mResources.constBegin(); iter != mResources.constEnd(); ++iter) {
+        QJsonObject entry;
+        entry.insert("file", iter.value().file);
+        entry.insert("contentType", iter.value().contentType);
+        entry.insert("etag", QString::fromLatin1(iter.value().etag));
+        entry.insert("lastModified", QString::fromLatin1(iter.value().lastModified));
+        entry.insert("size", static_cast<double>(iter.value().size));
+        index.insert(iter.key(), entry);
+    }
+
+    // Write to a temporary file first so a crash never leaves a broken index behind
+    QString path = resourcePath("index.json");
+    QFile file(path + ".tmp");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Failed to write offline cache index" << path;
+        return;
+    }
+
+    file.write(QJsonDocument(index).toJson(QJsonDocument::Compact));
+    file.close();
+
+    QFile::remove(path);
+    QFile::rename(file.fileName(), path);
+}
+
+} // namespace luna
+
+#include "offlinecache.moc"
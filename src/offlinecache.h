@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef OFFLINECACHE_H
+#define OFFLINECACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QUrl>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+namespace luna
+{
+
+/**
+ * Keeps a copy of the entry page of a remote application and the scripts,
+ * stylesheets and images it references below $XDG_CACHE_HOME. The copy is
+ * revalidated in the background with conditional requests once the page
+ * was loaded from the network and is used to build a self contained
+ * document when the entry point can't be reached. Building that document
+ * reads and encodes all cached resources so it's done on a worker thread.
+ */
+class OfflineCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    OfflineCache(const QString &appId, const QUrl &entryPoint, QObject *parent = 0);
+    ~OfflineCache();
+
+    bool isAvailable() const;
+    void prepareOfflineDocument();
+
+    void revalidate();
+
+Q_SIGNALS:
+    /**
+     * Emitted once the document requested with prepareOfflineDocument() is
+     * built, empty if there is none.
+     */
+    void offlineDocumentReady(const QString &document);
+
+    /**
+     * Emitted once all requests started by revalidate() are finished.
+     */
+    void revalidated();
+
+private Q_SLOTS:
+    void onReplyFinished();
+
+private:
+    friend class OfflineDocumentBuilder;
+
+    struct Resource
+    {
+        Resource() : size(0) { }
+
+        QString file;
+        QString contentType;
+        QByteArray etag;
+        QByteArray lastModified;
+        qint64 size;
+    };
+
+    struct Reference
+    {
+        int start;
+        int length;
+        QUrl url;
+    };
+
+    QString resourcePath(const QString &file) const;
+    QByteArray readResource(const QString &key) const;
+    static QList<Reference> findReferences(const QUrl &entryPoint, const QString &document);
+
+    void loadIndex();
+    void saveIndex();
+    void fetch(const QUrl &url);
+    void storeResource(const QString &key, QNetworkReply *reply);
+    void revalidateSubresources();
+    void dropUnreferenced(const QSet<QString> &referenced);
+
+    QString mDirectory;
+    QUrl mEntryPoint;
+    QHash<QString, Resource> mResources;
+    qint64 mTotalSize;
+    QNetworkAccessManager *mNetworkManager;
+    int mPendingReplies;
+    bool mRevalidated;
+};
+
+} // namespace luna
+
+#endif // OFFLINECACHE_H
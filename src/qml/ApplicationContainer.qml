@@ -18,10 +18,8 @@
 import QtQuick 2.0
 import QtWebKit 3.0
 import QtWebKit.experimental 1.0
-import "extensionmanager.js" as ExtensionManager
 import LunaNext.Common 0.1
 import LuneOS.Components 1.0
-import Connman 0.2
 import "."
 
 Flickable {
@@ -29,19 +27,18 @@ Flickable {
 
    anchors.fill: parent
 
-   property int numRestarts: 0
-   property int maxRestarts: 3
+   property bool offlinePanelWasShown: false
 
-   NetworkManager {
-       id: networkManager
+   Connections {
+       target: networkState
 
-       property string oldState: "unknown"
-
-       onStateChanged: {
-           // When we are online again reload the web view in order to start the application
-           // which is still visible to the user
-           if (oldState !== networkManager.state && networkManager.state === "online")
+       onWentOnline: {
+           // Only reload when the application couldn't load its content while we
+           // were offline. Everything else keeps its state.
+           if (webAppWindow.lastLoadFailed || offlinePanelWasShown)
                webView.reload();
+
+           offlinePanelWasShown = false;
        }
    }
 
@@ -49,9 +46,21 @@ Flickable {
         id: offlinePanel
 
         color: "white"
-        visible: webApp.internetConnectivityRequired && networkManager.state !== "online"
+        visible: webApp.internetConnectivityRequired && networkState.offline &&
+                 !webAppWindow.servingOfflineCopy
         anchors.fill: parent
 
+        onVisibleChanged: {
+            if (visible)
+                offlinePanelWasShown = true;
+        }
+
+        // we may be offline from the start on
+        Component.onCompleted: {
+            if (visible)
+                offlinePanelWasShown = true;
+        }
+
         z: 10
 
         Text {
@@ -104,7 +113,7 @@ Flickable {
         anchors.top: parent.top
         anchors.bottom: keyboardContainer.top
 
-        url: webAppUrl
+        // the url is set by loadApplication() once all extensions are ready
 
         UserAgent {
             id: userAgent
@@ -128,6 +137,9 @@ Flickable {
             if (webApp.userAgent.length > 0)
                 return webApp.userAgent;
 
+            if (url)
+                return userAgent.getUAString(url);
+
             return userAgent.defaultUA;
         }
 
@@ -189,21 +201,9 @@ Flickable {
         }
 
         onNavigationRequested: {
-            var action = WebView.AcceptRequest;
             var url = request.url.toString();
 
-            if (webApp.urlsAllowed && webApp.urlsAllowed.length !== 0) {
-                action = WebView.IgnoreRequest;
-                for (var i = 0; i < webApp.urlsAllowed.length; ++i) {
-                    var pattern = webApp.urlsAllowed[i];
-                    if (url.match(pattern)) {
-                        action = WebView.AcceptRequest;
-                        break;
-                    }
-                }
-            }
-
-            request.action = action;
+            request.action = webApp.isUrlAllowed(url) ? WebView.AcceptRequest : WebView.IgnoreRequest;
 
             // If we're not handling the URL forward it to be opened within the system
             // default web browser in a safe environment
@@ -212,69 +212,30 @@ Flickable {
                 return;
             }
 
-            webView.experimental.userAgent = getUserAgentForApp(url);
-        }
-
-        Component.onCompleted: {
-            // Only when we have a system application we enable the webOS API and the
-            // PalmServiceBridge to avoid remote applications accessing unwanted system
-            // internals
-            if (webAppWindow.trustScope === "system") {
-                if (experimental.hasOwnProperty('userScriptsInjectAtStart') &&
-                    experimental.hasOwnProperty('userScriptsForAllFrames')) {
-                    experimental.userScripts = webAppWindow.userScripts;
-                    experimental.userScriptsInjectAtStart = true;
-                    experimental.userScriptsForAllFrames = true;
-                }
-
-                if (experimental.preferences.hasOwnProperty("palmServiceBridgeEnabled"))
-                    experimental.preferences.palmServiceBridgeEnabled = true;
-
-                if (experimental.preferences.hasOwnProperty("privileged"))
-                    experimental.preferences.privileged = webApp.privileged;
-            }
-
-            if (experimental.preferences.hasOwnProperty("logsPageMessagesToSystemConsole"))
-                experimental.preferences.logsPageMessagesToSystemConsole = true;
-
-            if (experimental.preferences.hasOwnProperty("suppressIncrementalRendering"))
-                experimental.preferences.suppressIncrementalRendering = true;
-
-            if (experimental.preferences.hasOwnProperty("identifier"))
-                experimental.preferences.identifier = webApp.identifier;
+            var userAgentForUrl = getUserAgentForApp(url);
+            if (webView.experimental.userAgent !== userAgentForUrl)
+                webView.experimental.userAgent = userAgentForUrl;
         }
 
-        experimental.onMessageReceived: {
-            ExtensionManager.messageHandler(message);
+        WebViewController {
+            view: webView
+            suppressIncrementalRendering: true
         }
+    }
 
-        Connections {
-            target: webAppWindow
-
-            onJavaScriptExecNeeded: {
-                webView.experimental.evaluateJavaScript(script);
-            }
-
-            onExtensionWantsToBeAdded: {
-                ExtensionManager.addExtension(name, object);
-            }
-        }
+    // Stands in for the web view while the window is suspended. The card
+    // keeps showing the last frame while the hidden web view lets WebKit
+    // throttle the page, and nothing is left to render new frames.
+    ShaderEffectSource {
+        id: suspendedFrame
+        anchors.fill: webView
+        sourceItem: webView
+        live: false
+        visible: webAppWindow.suspended
 
-        Connections {
-            target: webView.experimental
-            onProcessDidCrash: {
-                if (numRestarts < maxRestarts) {
-                    console.log("ERROR: The web process has crashed. Restart it ...");
-                    webView.url = webAppUrl;
-                    webView.reload();
-                    numRestarts += 1;
-                }
-                else {
-                    console.log("CRITICAL: restarted application " + numRestarts
-                                + " times. Closing it now");
-                    Qt.quit();
-                }
-            }
+        onVisibleChanged: {
+            if (visible)
+                scheduleUpdate();
         }
     }
 
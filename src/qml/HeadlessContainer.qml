@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+import QtQuick 2.0
+import QtWebKit 3.0
+import QtWebKit.experimental 1.0
+
+// Stripped down container for the background page of headless applications.
+// It never gets a window so everything needed to present content (loading
+// animation, dialogs, keyboard handling, offline panel) is left out and the
+// web view is kept hidden so it doesn't paint at all. Child windows opened by
+// the application get the full Window.qml as usual.
+Item {
+    id: headlessContainer
+
+    WebView {
+        id: webView
+        objectName: "webView"
+
+        anchors.fill: parent
+        visible: false
+
+        // the url is set by loadApplication() once all extensions are ready
+
+        experimental.preferences.navigatorQtObjectEnabled: true
+        experimental.preferences.localStorageEnabled: true
+        experimental.preferences.developerExtrasEnabled: true
+        experimental.preferences.universalAccessFromFileURLsAllowed: true
+        experimental.preferences.fileAccessFromFileURLsAllowed: true
+
+        WebViewController {
+            view: webView
+        }
+    }
+}
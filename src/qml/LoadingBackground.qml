@@ -64,7 +64,8 @@ Image {
 
     SequentialAnimation {
         id: loadingAnimation
-        running: true
+        running: loadingBackground.visible && !webAppWindow.suspended &&
+                 lastFrameSnapshot.status !== Image.Ready
         loops: Animation.Infinite
 
         NumberAnimation {
@@ -85,4 +86,16 @@ Image {
             duration: 700
         }
     }
+
+    // The last frame the application showed before it was closed is put on
+    // top of everything and cross-faded to the live content once the stage
+    // is ready. Decoding happens asynchronously on a loader thread.
+    Image {
+        id: lastFrameSnapshot
+        anchors.fill: parent
+        source: webAppWindow.snapshot
+        asynchronous: true
+        cache: false
+        visible: status === Image.Ready
+    }
 }
@@ -49,42 +49,25 @@ Item {
 
     property var overrides: Overrides.overrides
 
-    function getDomain(url) {
-        var domain = url.toString()
-        var indexOfScheme = domain.indexOf("://")
-        if (indexOfScheme !== -1) {
-            domain = domain.slice(indexOfScheme + 3)
-        }
-        var indexOfPath = domain.indexOf("/")
-        if (indexOfPath !== -1) {
-            domain = domain.slice(0, indexOfPath)
-        }
-        return domain
+    // The overrides are resolved to their final user agent string once per
+    // process and stored in a native lookup table
+    function getUAString(url) {
+        return userAgentOverrides.lookup(url.toString(), defaultUA)
     }
 
-    function getDomains(domain) {
-        var components = domain.split(".")
-        var domains = []
-        for (var i = 0; i < components.length; i++) {
-            domains.push(components.slice(i).join("."))
-        }
-        return domains
-    }
+    Component.onCompleted: {
+        if (userAgentOverrides.loaded)
+            return
 
-    function getUAString(url) {
-        var ua = defaultUA
-        var domains = getDomains(getDomain(url))
-        for (var i = 0; i < domains.length; i++) {
-            var domain = domains[i]
-            if (domain in overrides) {
-                var form = overrides[domain]
-                if (typeof form == "string") {
-                    return form
-                } else if (typeof form == "object") {
-                    return ua.replace(form[0], form[1])
-                }
+        var resolved = {}
+        for (var domain in overrides) {
+            var form = overrides[domain]
+            if (typeof form == "string") {
+                resolved[domain] = form
+            } else if (typeof form == "object") {
+                resolved[domain] = defaultUA.replace(form[0], form[1])
             }
         }
-        return ua
+        userAgentOverrides.load(resolved)
     }
 }
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+import QtQuick 2.0
+import QtWebKit 3.0
+import QtWebKit.experimental 1.0
+import "extensionmanager.js" as ExtensionManager
+
+// Everything the application and headless containers do the same way with
+// their web view: the webOS specific preferences, loading the application
+// once its extensions are ready, the bridge to the extensions and
+// restarting the web process after a crash.
+Item {
+    id: controller
+
+    property WebView view
+    property bool suppressIncrementalRendering: false
+
+    property int numRestarts: 0
+    property int maxRestarts: 3
+
+    visible: false
+
+    Component.onCompleted: {
+        var experimental = view.experimental;
+
+        // Only when we have a system application we enable the webOS API and the
+        // PalmServiceBridge to avoid remote applications accessing unwanted system
+        // internals
+        if (webAppWindow.trustScope === "system") {
+            if (experimental.hasOwnProperty('userScriptsInjectAtStart') &&
+                experimental.hasOwnProperty('userScriptsForAllFrames')) {
+                experimental.userScriptsInjectAtStart = true;
+                experimental.userScriptsForAllFrames = true;
+            }
+
+            if (experimental.preferences.hasOwnProperty("palmServiceBridgeEnabled"))
+                experimental.preferences.palmServiceBridgeEnabled = true;
+
+            if (experimental.preferences.hasOwnProperty("privileged"))
+                experimental.preferences.privileged = webApp.privileged;
+        }
+
+        if (experimental.preferences.hasOwnProperty("logsPageMessagesToSystemConsole"))
+            experimental.preferences.logsPageMessagesToSystemConsole = true;
+
+        if (suppressIncrementalRendering &&
+            experimental.preferences.hasOwnProperty("suppressIncrementalRendering"))
+            experimental.preferences.suppressIncrementalRendering = true;
+
+        if (experimental.preferences.hasOwnProperty("identifier"))
+            experimental.preferences.identifier = webApp.identifier;
+
+        if (webAppWindow.extensionsReady)
+            loadApplication();
+    }
+
+    function loadApplication() {
+        // Plugin extensions bring their own user scripts so they can only
+        // be injected once the plugin has been loaded
+        if (webAppWindow.trustScope === "system" &&
+            view.experimental.hasOwnProperty('userScriptsInjectAtStart'))
+            view.experimental.userScripts = webAppWindow.userScripts;
+
+        view.url = webAppUrl;
+    }
+
+    Connections {
+        target: webAppWindow
+
+        onJavaScriptExecNeeded: {
+            view.experimental.evaluateJavaScript(script);
+        }
+
+        onExtensionWantsToBeAdded: {
+            ExtensionManager.addExtension(name, object);
+        }
+
+        onExtensionsReadyChanged: {
+            controller.loadApplication();
+        }
+    }
+
+    Timer {
+        id: restartTimer
+        repeat: false
+        onTriggered: {
+            // Bring the application back to where it was before the crash.
+            // That page may be what crashes the web process so when the
+            // restore crashed again we start over with the entry point.
+            var url = webAppWindow.lastCommittedUrl.toString();
+            view.url = (url.length > 0 && numRestarts <= 1) ? url : webAppUrl;
+            view.reload();
+        }
+    }
+
+    Connections {
+        target: view.experimental
+
+        onMessageReceived: {
+            ExtensionManager.messageHandler(message);
+        }
+
+        onProcessDidCrash: {
+            webAppWindow.recordProcessCrash();
+
+            if (numRestarts < maxRestarts) {
+                // back off exponentially to not hammer the system when the
+                // application crashes right away again
+                restartTimer.interval = 250 * Math.pow(2, numRestarts);
+                console.log("ERROR: The web process has crashed. Restart it in " +
+                            restartTimer.interval + " ms ...");
+                restartTimer.restart();
+                numRestarts += 1;
+            }
+            else {
+                console.log("CRITICAL: restarted application " + numRestarts
+                            + " times. Closing it now");
+                Qt.quit();
+            }
+        }
+    }
+}
@@ -31,14 +31,20 @@ function messageHandler(message) {
     if (received.messageType === "callExtensionFunction") {
         if (typeof received.extension === 'undefined' || typeof received.func === 'undefined')
             return false;
-        execMethod(received.extension, received.func, received.params);
+        execMethod(received.extension, received.func, received.params, received.hasCallbacks === true,
+                   message.data.length);
     }
     return true;
 }
 
-function execMethod(extensionName, functionName, params) {
-    if (typeof extensionObjects[extensionName][functionName] != "function")
-        return false;
-    extensionObjects[extensionName][functionName].apply(this, params);
-    return true;
+function execMethod(extensionName, functionName, params, hasCallbacks, size) {
+    // extensions are constructed on their first call and added through
+    // addExtension right away
+    if (typeof extensionObjects[extensionName] === 'undefined')
+        webAppWindow.loadExtension(extensionName);
+
+    // the window runs the call on the thread of the extension and accounts
+    // for it in the bridge statistics
+    return webAppWindow.dispatchExtensionCall(extensionName, functionName, params, hasCallbacks,
+                                              size === undefined ? 0 : size);
 }
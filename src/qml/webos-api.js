@@ -83,7 +83,7 @@ _webOS.exec = function(successCallback, errorCallback, extensionName, functionNa
     parameters.unshift(ecId);
     parameters.unshift(scId);
 
-    navigator.qt.postMessage(JSON.stringify({messageType: "callExtensionFunction", extension: extensionName, func: functionName, params: parameters}))
+    navigator.qt.postMessage(JSON.stringify({messageType: "callExtensionFunction", extension: extensionName, func: functionName, params: parameters, hasCallbacks: true}))
     return true;
 }
 
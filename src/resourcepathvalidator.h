@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef RESOURCEPATHVALIDATOR_H
+#define RESOURCEPATHVALIDATOR_H
+
+#include <QString>
+#include <QStringList>
+
+namespace luna
+{
+
+/**
+ * Decides which local files an application may read through
+ * PalmSystem.getResource depending on whether it's privileged or not.
+ */
+class ResourcePathValidator
+{
+public:
+    static ResourcePathValidator& instance();
+
+    bool validate(const QString &path, bool privileged);
+
+private:
+    ResourcePathValidator();
+
+    bool findPathInList(const QStringList &list, const QString &path);
+
+    QStringList mAllowedTargetPaths;
+    QStringList mPrivilegedAppPaths;
+    QStringList mUnprivilegedAppPaths;
+};
+
+} // namespace luna
+
+#endif // RESOURCEPATHVALIDATOR_H
@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <QThread>
+
+#include <baseextension.h>
+
+#include "sharedextensionenvironment.h"
+#include "extensiondispatcher.h"
+#include "bridgestatistics.h"
+#include "webapplication.h"
+#include "webapplicationplugin.h"
+#include "webapplicationwindow.h"
+
+namespace luna
+{
+
+SharedExtensionEnvironment::SharedExtensionEnvironment(WebApplicationPlugin *plugin, QObject *parent) :
+    ApplicationEnvironment(parent),
+    mPlugin(plugin),
+    mExtensionsCreated(false),
+    // start with an even id as success and error callbacks come in pairs
+    mNextCallbackId(2),
+    mCreationTime(0),
+    mReuseCount(0)
+{
+}
+
+SharedExtensionEnvironment::~SharedExtensionEnvironment()
+{
+    if (mReuseCount > 0)
+        qDebug() << "Sharing plugin extensions between windows saved" << mReuseCount << "constructions,"
+                 << "about" << mReuseCount * mCreationTime << "ms";
+
+    runLifecycleHook([](BaseExtension *extension) {
+        extension->teardown();
+    });
+
+    qDeleteAll(mDispatchers.values());
+    qDeleteAll(mExtensions);
+}
+
+/**
+ * Creates the extensions of the plugin once; every later window gets the
+ * same instances.
+ */
+QList<BaseExtension*> SharedExtensionEnvironment::extensions()
+{
+    if (mExtensionsCreated) {
+        mReuseCount++;
+        return mExtensions;
+    }
+
+    mExtensionsCreated = true;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    mExtensions = mPlugin->createExtensions(this);
+
+    mCreationTime = timer.elapsed();
+
+    Q_FOREACH(BaseExtension *extension, mExtensions) {
+        if (extension->threadAffinity() == BaseExtension::GuiThreadAffinity)
+            continue;
+
+        if (extension->parent()) {
+            qWarning() << "Extension" << extension->name() << "has a parent, running it on the GUI thread";
+            continue;
+        }
+
+        mDispatchers.insert(extension, new ExtensionDispatcher(extension));
+    }
+
+    return mExtensions;
+}
+
+QList<QUrl> SharedExtensionEnvironment::userScripts() const
+{
+    return mUserScripts;
+}
+
+void SharedExtensionEnvironment::registerUserScript(const QUrl &path)
+{
+    mUserScripts.append(path);
+}
+
+void SharedExtensionEnvironment::initialize(WebApplicationWindow *window, BaseExtension *extension)
+{
+    addWindow(window);
+
+    if (mDispatchers.contains(extension))
+        mDispatchers.value(extension)->initialize();
+    else
+        extension->initialize();
+}
+
+/**
+ * Calls made through _webOS.exec carry the ids of their success and error
+ * callbacks as first two parameters; those are replaced by ids unique for
+ * all windows of the application.
+ */
+void SharedExtensionEnvironment::call(WebApplicationWindow *window, BaseExtension *extension,
+                                      const QString &funcName, QVariantList params, bool hasCallbacks,
+                                      int bytesIn)
+{
+    addWindow(window);
+
+    if (hasCallbacks && params.count() >= 2) {
+        qint64 successId = params[0].toLongLong();
+        qint64 mappedId = mapCallbackId(window, successId);
+
+        params[0] = mappedId;
+        params[1] = mappedId + 1;
+    }
+
+    QString appId = window->application()->id();
+
+    if (mDispatchers.contains(extension)) {
+        mDispatchers.value(extension)->call(funcName, params, appId, bytesIn);
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    ExtensionDispatcher::invokeMethod(extension, funcName, params);
+
+    BridgeStatistics::instance()->recordCall(appId, extension->name(), funcName,
+                                             BridgeStatistics::AsynchronousCall,
+                                             timer.nsecsElapsed() / 1000, bytesIn, 0);
+}
+
+QString SharedExtensionEnvironment::callSynchronous(WebApplicationWindow *window, BaseExtension *extension,
+                                                    const QString &funcName, const QJsonArray &params)
+{
+    addWindow(window);
+
+    if (mDispatchers.contains(extension))
+        return mDispatchers.value(extension)->callSynchronous(funcName, params);
+
+    return extension->handleSynchronousCall(funcName, params);
+}
+
+qint64 SharedExtensionEnvironment::mapCallbackId(WebApplicationWindow *window, qint64 id)
+{
+    qint64 mappedId = mNextCallbackId;
+    mNextCallbackId += 2;
+
+    // the page uses even ids for success and the following odd id for
+    // error callbacks
+    CallbackTarget target;
+    target.window = window;
+    target.id = id;
+    mCallbacks.insert(mappedId, target);
+
+    return mappedId;
+}
+
+void SharedExtensionEnvironment::addWindow(WebApplicationWindow *window)
+{
+    if (!mWindows.contains(window))
+        mWindows.append(window);
+}
+
+void SharedExtensionEnvironment::removeWindow(WebApplicationWindow *window)
+{
+    mWindows.removeAll(window);
+
+    QHash<qint64, CallbackTarget>::iterator iter = mCallbacks.begin();
+    while (iter != mCallbacks.end()) {
+        if (iter.value().window == window)
+            iter = mCallbacks.erase(iter);
+        else
+            ++iter;
+    }
+}
+
+void SharedExtensionEnvironment::executeScript(const QString &script)
+{
+    // Routing is only done on the GUI thread so windows can't go away in
+    // between
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, "routeScript", Qt::QueuedConnection, Q_ARG(QString, script));
+        return;
+    }
+
+    routeScript(script);
+}
+
+void SharedExtensionEnvironment::routeScript(const QString &script)
+{
+    static QRegularExpression callbackExpression("^_webOS\\.(callback|callbackWithoutRemove)\\((\\d+)");
+
+    QRegularExpressionMatch match = callbackExpression.match(script);
+    if (!match.hasMatch()) {
+        // Nothing tells which page the script is meant for; the extension is
+        // shared so it is an event for all of them
+        Q_FOREACH(WebApplicationWindow *window, mWindows)
+            window->executeScript(script);
+        return;
+    }
+
+    qint64 id = match.captured(2).toLongLong();
+    qint64 pairId = id & ~1LL;
+
+    if (!mCallbacks.contains(pairId)) {
+        qWarning() << "Dropping callback" << id << "for a window which is gone";
+        return;
+    }
+
+    CallbackTarget target = mCallbacks.value(pairId);
+    qint64 localId = target.id + (id - pairId);
+
+    if (match.captured(1) == "callback")
+        mCallbacks.remove(pairId);
+
+    QString localScript = script;
+    localScript.replace(match.capturedStart(2), match.capturedLength(2), QString::number(localId));
+
+    target.window->executeScript(localScript);
+}
+
+/**
+ * Runs a lifecycle hook on all shared extensions, if their plugin knows
+ * about lifecycle hooks at all.
+ */
+void SharedExtensionEnvironment::runLifecycleHook(const std::function<void(BaseExtension*)> &hook)
+{
+    if (!mExtensionsCreated || !mPlugin->hasLifecycleHooks())
+        return;
+
+    Q_FOREACH(BaseExtension *extension, mExtensions) {
+        if (mDispatchers.contains(extension))
+            mDispatchers.value(extension)->runHook(hook);
+        else
+            hook(extension);
+    }
+}
+
+} // namespace luna
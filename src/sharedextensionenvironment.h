@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef SHAREDEXTENSIONENVIRONMENT_H
+#define SHAREDEXTENSIONENVIRONMENT_H
+
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QUrl>
+#include <QVariantList>
+
+#include <applicationenvironment.h>
+
+#include <functional>
+
+namespace luna
+{
+
+class BaseExtension;
+class ExtensionDispatcher;
+class WebApplicationPlugin;
+class WebApplicationWindow;
+
+/**
+ * Environment of plugin extensions which are shared by all windows of an
+ * application. The callback ids of calls coming from the different pages
+ * are mapped to ids unique for the application so callbacks can be routed
+ * back to the page of the window which made the call. Scripts which are no
+ * callbacks, like events fired by the extension, go to all windows.
+ */
+class SharedExtensionEnvironment : public ApplicationEnvironment
+{
+    Q_OBJECT
+public:
+    explicit SharedExtensionEnvironment(WebApplicationPlugin *plugin, QObject *parent = 0);
+    ~SharedExtensionEnvironment();
+
+    void executeScript(const QString &script);
+    void registerUserScript(const QUrl &path);
+
+    QList<BaseExtension*> extensions();
+    QList<QUrl> userScripts() const;
+
+    void initialize(WebApplicationWindow *window, BaseExtension *extension);
+    void call(WebApplicationWindow *window, BaseExtension *extension, const QString &funcName,
+              QVariantList params, bool hasCallbacks, int bytesIn);
+    QString callSynchronous(WebApplicationWindow *window, BaseExtension *extension,
+                            const QString &funcName, const QJsonArray &params);
+
+    void removeWindow(WebApplicationWindow *window);
+
+    void runLifecycleHook(const std::function<void(BaseExtension*)> &hook);
+
+private Q_SLOTS:
+    void routeScript(const QString &script);
+
+private:
+    struct CallbackTarget
+    {
+        WebApplicationWindow *window;
+        qint64 id;
+    };
+
+    qint64 mapCallbackId(WebApplicationWindow *window, qint64 id);
+    void addWindow(WebApplicationWindow *window);
+
+    WebApplicationPlugin *mPlugin;
+    bool mExtensionsCreated;
+    QList<BaseExtension*> mExtensions;
+    QMap<BaseExtension*, ExtensionDispatcher*> mDispatchers;
+    QList<QUrl> mUserScripts;
+    QHash<qint64, CallbackTarget> mCallbacks;
+    qint64 mNextCallbackId;
+    QList<WebApplicationWindow*> mWindows;
+    qint64 mCreationTime;
+    int mReuseCount;
+};
+
+} // namespace luna
+
+#endif // SHAREDEXTENSIONENVIRONMENT_H
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QThreadPool>
+
+#include <Settings.h>
+
+#include "snapshotcache.h"
+#include "utils.h"
+
+#define SNAPSHOT_SCALE          0.5
+#define SNAPSHOT_QUALITY        70
+#define SNAPSHOT_DISK_BUDGET    (4 * 1024 * 1024)
+
+namespace luna
+{
+
+class SnapshotWriter : public QRunnable
+{
+public:
+    SnapshotWriter(const QString &directory, const QString &path, const QImage &frame) :
+        mDirectory(directory),
+        mPath(path),
+        mFrame(frame)
+    {
+    }
+
+    void run()
+    {
+        QImage snapshot = mFrame.scaled(mFrame.size() * SNAPSHOT_SCALE, Qt::KeepAspectRatio,
+                                        Qt::SmoothTransformation);
+
+        // QSaveFile writes to a temporary file of its own and renames it in
+        // place so a launch never sees a half written snapshot, even when
+        // two writers for the same app run at the same time
+        QSaveFile file(mPath);
+        if (!file.open(QIODevice::WriteOnly) ||
+            !snapshot.save(&file, "JPG", SNAPSHOT_QUALITY) || !file.commit()) {
+            qWarning() << "Failed to write application snapshot" << mPath;
+            return;
+        }
+
+        enforceDiskBudget();
+    }
+
+private:
+    void enforceDiskBudget()
+    {
+        QFileInfoList snapshots = QDir(mDirectory).entryInfoList(QStringList() << "*.jpg",
+                                                                 QDir::Files, QDir::Time);
+
+        // entries are sorted newest first so we drop from the end
+        qint64 totalSize = 0;
+        Q_FOREACH(const QFileInfo &snapshot, snapshots)
+            totalSize += snapshot.size();
+
+        while (totalSize > SNAPSHOT_DISK_BUDGET && !snapshots.isEmpty()) {
+            QFileInfo oldest = snapshots.takeLast();
+            totalSize -= oldest.size();
+            QFile::remove(oldest.absoluteFilePath());
+        }
+    }
+
+    QString mDirectory;
+    QString mPath;
+    QImage mFrame;
+};
+
+QString SnapshotCache::cacheDirectory()
+{
+    return launcherCachePath("snapshots");
+}
+
+QString SnapshotCache::snapshotPath(const QString &appId)
+{
+    return QString("%1/%2@%3.jpg").arg(cacheDirectory()).arg(appId)
+            .arg(Settings::LunaSettings()->layoutScale);
+}
+
+QUrl SnapshotCache::snapshotUrl(const QString &appId)
+{
+    QString path = snapshotPath(appId);
+
+    if (!QFile::exists(path))
+        return QUrl();
+
+    return QUrl::fromLocalFile(path);
+}
+
+void SnapshotCache::store(const QString &appId, const QImage &frame)
+{
+    if (frame.isNull())
+        return;
+
+    QDir().mkpath(cacheDirectory());
+
+    QThreadPool::globalInstance()->start(new SnapshotWriter(cacheDirectory(), snapshotPath(appId), frame));
+}
+
+} // namespace luna
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef SNAPSHOTCACHE_H
+#define SNAPSHOTCACHE_H
+
+#include <QImage>
+#include <QString>
+#include <QUrl>
+
+namespace luna
+{
+
+/**
+ * Stores a downscaled snapshot of the last frame an application rendered so
+ * it can be shown as placeholder while the application starts next time.
+ * Snapshots are keyed by application id and layout scale and written by a
+ * worker thread. The whole cache is kept below a fixed disk budget.
+ */
+class SnapshotCache
+{
+public:
+    static QUrl snapshotUrl(const QString &appId);
+    static void store(const QString &appId, const QImage &frame);
+
+private:
+    static QString cacheDirectory();
+    static QString snapshotPath(const QString &appId);
+};
+
+} // namespace luna
+
+#endif // SNAPSHOTCACHE_H
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+
+#include <math.h>
+
+#include "stagereadyhistory.h"
+#include "utils.h"
+
+#define MAX_SAMPLES             20
+#define NEVER_SIGNALED          -1
+// number of consecutive launches without stageReady() before we stop waiting for it
+#define NEVER_SIGNALED_LIMIT    3
+#define DEFAULT_TIMEOUT_MS      3000
+#define MIN_TIMEOUT_MS          500
+#define MAX_TIMEOUT_MS          8000
+#define TIMEOUT_MARGIN_MS       250
+#define TIMEOUT_PERCENTILE      0.9
+
+namespace luna
+{
+
+StageReadyHistory::StageReadyHistory(const QString &appId)
+{
+    QString cacheDir = launcherCachePath("stage-ready");
+    QDir().mkpath(cacheDir);
+
+    mPath = QString("%1/%2").arg(cacheDir).arg(appId);
+
+    load();
+}
+
+void StageReadyHistory::load()
+{
+    QFile file(mPath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return;
+
+    QTextStream stream(&file);
+    while (!stream.atEnd()) {
+        bool ok = false;
+        int sample = stream.readLine().toInt(&ok);
+        if (ok)
+            mSamples.append(sample);
+    }
+
+    while (mSamples.count() > MAX_SAMPLES)
+        mSamples.removeFirst();
+}
+
+void StageReadyHistory::save()
+{
+    QFile file(mPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qWarning() << "Failed to store stage ready history at" << mPath;
+        return;
+    }
+
+    QTextStream stream(&file);
+    Q_FOREACH(int sample, mSamples)
+        stream << sample << "\n";
+}
+
+void StageReadyHistory::addSample(int duration)
+{
+    mSamples.append(qMax(duration, 0));
+
+    while (mSamples.count() > MAX_SAMPLES)
+        mSamples.removeFirst();
+
+    save();
+}
+
+void StageReadyHistory::addNeverSignaledSample()
+{
+    mSamples.append(NEVER_SIGNALED);
+
+    while (mSamples.count() > MAX_SAMPLES)
+        mSamples.removeFirst();
+
+    save();
+}
+
+bool StageReadyHistory::neverSignals() const
+{
+    if (mSamples.count() < NEVER_SIGNALED_LIMIT)
+        return false;
+
+    for (int n = mSamples.count() - NEVER_SIGNALED_LIMIT; n < mSamples.count(); n++) {
+        if (mSamples.at(n) != NEVER_SIGNALED)
+            return false;
+    }
+
+    return true;
+}
+
+int StageReadyHistory::timeout() const
+{
+    // Don't keep the user waiting for a call which most likely doesn't come
+    if (neverSignals())
+        return MIN_TIMEOUT_MS;
+
+    QList<int> durations;
+    Q_FOREACH(int sample, mSamples) {
+        if (sample != NEVER_SIGNALED)
+            durations.append(sample);
+    }
+
+    if (durations.isEmpty())
+        return DEFAULT_TIMEOUT_MS;
+
+    qSort(durations);
+
+    int index = qMax(0, (int) ceil(durations.count() * TIMEOUT_PERCENTILE) - 1);
+    int timeout = durations.at(index) + TIMEOUT_MARGIN_MS;
+
+    return qBound(MIN_TIMEOUT_MS, timeout, MAX_TIMEOUT_MS);
+}
+
+} // namespace luna
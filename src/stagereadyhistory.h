@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef STAGEREADYHISTORY_H
+#define STAGEREADYHISTORY_H
+
+#include <QString>
+#include <QList>
+
+namespace luna
+{
+
+/**
+ * Remembers how long an application took from finishing its page load until
+ * it called stageReady() over its last launches. The history is stored below
+ * XDG_CACHE_HOME and used to decide how long we wait for stageReady() before
+ * showing the window anyway.
+ */
+class StageReadyHistory
+{
+public:
+    explicit StageReadyHistory(const QString &appId);
+
+    void addSample(int duration);
+    void addNeverSignaledSample();
+
+    bool neverSignals() const;
+    int timeout() const;
+
+private:
+    QString mPath;
+    QList<int> mSamples;
+
+    void load();
+    void save();
+};
+
+} // namespace luna
+
+#endif // STAGEREADYHISTORY_H
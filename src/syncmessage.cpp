@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "syncmessage.h"
+#include "jsonreader.h"
+
+namespace luna
+{
+
+bool SyncMessage::decode(const QString &data, SyncMessage &message)
+{
+    JsonReader reader(data.toUtf8());
+
+    if (!reader.isObject())
+        return false;
+
+    if (!reader.isString("messageType"))
+        return false;
+
+    if (reader.stringValue("messageType") != "callSyncExtensionFunction")
+        return false;
+
+    if (!reader.isString("extension") || !reader.isString("func") || !reader.isArray("params"))
+        return false;
+
+    message.extension = reader.stringValue("extension");
+    message.func = reader.stringValue("func");
+    message.params = reader.arrayValue("params");
+
+    return true;
+}
+
+} // namespace luna
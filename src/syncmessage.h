@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef SYNCMESSAGE_H
+#define SYNCMESSAGE_H
+
+#include <QJsonArray>
+#include <QString>
+
+namespace luna
+{
+
+/**
+ * A synchronous extension call as sent by the page through the experimental
+ * navigator.qt.postSyncMessage channel.
+ */
+struct SyncMessage
+{
+    QString extension;
+    QString func;
+    QJsonArray params;
+
+    /**
+     * Decodes the data of a callSyncExtensionFunction message. Returns false
+     * if the data isn't such a message or if any of the fields is missing.
+     */
+    static bool decode(const QString &data, SyncMessage &message);
+};
+
+} // namespace luna
+
+#endif // SYNCMESSAGE_H
@@ -16,14 +16,14 @@
  */
 
 #include <QDebug>
-#include <QJsonDocument>
-#include <QJsonObject>
 
 #include <time.h>
 
 #include <luna-service2++/message.hpp>
 
 #include "systemtime.h"
+#include "lunaservicethread.h"
+#include "jsonreader.h"
 
 namespace luna
 {
@@ -43,7 +43,9 @@ SystemTime::SystemTime() :
 {
     qDebug() << __PRETTY_FUNCTION__ << "Registering for system time changes ...";
 
-    mLunaPrivHandle.attachToLoop(g_main_context_default());
+    mReceiverId = LunaServiceThread::instance()->registerReceiver();
+
+    mLunaPrivHandle.attachToLoop(LunaServiceThread::instance()->context());
 
     LS::ServerStatusCallback callback = [&] (bool isActive) {
         if (!isActive)
@@ -56,7 +58,10 @@ SystemTime::SystemTime() :
         return true;
     };
 
-    mServerStatus = mLunaPrivHandle.registerServerStatus("com.palm.systemservice", callback);
+    // The handle is served by the service thread, so register there as well
+    LunaServiceThread::instance()->schedule([=]() {
+        mServerStatus = mLunaPrivHandle.registerServerStatus("com.palm.systemservice", callback);
+    });
 }
 
 QString SystemTime::timezone() const
@@ -75,24 +80,29 @@ void SystemTime::updateFromService(LSMessage *message)
 {
     LS::Message msg{message};
 
-    QJsonDocument document = QJsonDocument::fromJson(QByteArray(msg.getPayload()));
+    JsonReader root(QByteArray(msg.getPayload()));
+
+    if (!root.isObject())
+        return;
 
-    if (!document.isObject())
+    if (!root.contains("timezone"))
         return;
 
-    QJsonObject root = document.object();
+    QString timezone = root.stringValue("timezone", "");
+
+    // We're on the luna service thread here; the timezone is only updated on
+    // the GUI thread where it's read from
+    LunaServiceThread::instance()->post(mReceiverId, [=]() {
+        if (timezone == mTimezone)
+            return;
 
-    if (root.contains("timezone")) {
-        QString timezone = root.value("timezone").toString("");
-        if (timezone != mTimezone) {
-            mTimezone = timezone;
+        mTimezone = timezone;
 
-            setenv("TZ", mTimezone.toUtf8().constData(), 1);
-            tzset();
+        setenv("TZ", mTimezone.toUtf8().constData(), 1);
+        tzset();
 
-            qDebug() << __PRETTY_FUNCTION__ << "timezone has changed to" << mTimezone;
-        }
-    }
+        qDebug() << __PRETTY_FUNCTION__ << "timezone has changed to" << mTimezone;
+    });
 }
 
 } // namespace luna
@@ -45,6 +45,7 @@ private:
     LS::ServerStatus mServerStatus;
     LS::Call mSubscriptionCall;
     QString mTimezone;
+    int mReceiverId;
 };
 
 } // namespace luna
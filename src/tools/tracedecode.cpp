@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/*
+ * Prints the events of a dump written by the launcher's event trace in the
+ * order they were recorded:
+ *
+ *   webapp-trace-decode <file>
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "../eventtraceformat.h"
+
+using namespace luna;
+
+static bool compareSequence(const TraceEvent &a, const TraceEvent &b)
+{
+    return a.sequence < b.sequence;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <trace file>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+    if (!file) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    TraceHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s is no event trace\n", argv[1]);
+        fclose(file);
+        return 1;
+    }
+
+    if (header.version != TRACE_FORMAT_VERSION || header.eventSize != sizeof(TraceEvent)) {
+        fprintf(stderr, "Unsupported trace format version %u\n", header.version);
+        fclose(file);
+        return 1;
+    }
+
+    std::vector<TraceEvent> events;
+    events.reserve(header.capacity);
+
+    TraceEvent event;
+    for (uint32_t n = 0; n < header.capacity && fread(&event, sizeof(event), 1, file) == 1; n++) {
+        // empty or still being written when the dump was taken
+        if (event.sequence == 0)
+            continue;
+
+        event.tag[TRACE_TAG_SIZE - 1] = '\0';
+        events.push_back(event);
+    }
+
+    fclose(file);
+
+    std::sort(events.begin(), events.end(), compareSequence);
+
+    time_t dumpTime = header.realTime / 1000000000ULL;
+    char dumpTimeString[64];
+    strftime(dumpTimeString, sizeof(dumpTimeString), "%Y-%m-%d %H:%M:%S", localtime(&dumpTime));
+
+    printf("pid %u, dumped at %s, %llu events recorded, %zu in the dump\n",
+           header.pid, dumpTimeString, (unsigned long long) header.recorded, events.size());
+
+    for (size_t n = 0; n < events.size(); n++) {
+        const TraceEvent &current = events[n];
+
+        // times are relative to the dump, older events have negative ones
+        double offset = ((double) current.timestamp - (double) header.monotonicTime) / 1000000.0;
+
+        printf("%12.3f ms  %5u  %-18s %10u %10u  %s\n", offset, current.thread,
+               traceEventTypeName(current.type), current.value, current.extra, current.tag);
+    }
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QDebug>
+
+#include "urlpatternmatcher.h"
+
+#define MAX_CACHED_RESULTS  64
+
+namespace luna
+{
+
+/*
+ * Tells whether the pattern refers back to a group by number or name, like
+ * \1, \g{1}, \k<name> or (?P=name). Escaped backslashes are skipped so a
+ * literal \\1 doesn't count.
+ */
+static bool hasBackreference(const QString &pattern)
+{
+    for (int n = 0; n < pattern.length() - 1; n++) {
+        if (pattern.at(n) == QLatin1Char('\\')) {
+            const QChar next = pattern.at(n + 1);
+            if ((next >= QLatin1Char('1') && next <= QLatin1Char('9')) ||
+                next == QLatin1Char('g') || next == QLatin1Char('k'))
+                return true;
+            n++;
+        }
+        else if (pattern.midRef(n, 4) == QLatin1String("(?P=")) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+UrlPatternMatcher::UrlPatternMatcher(const QStringList &patterns) :
+    mEmpty(true)
+{
+    QStringList alternatives;
+    QList<QRegularExpression> expressions;
+
+    Q_FOREACH(const QString &pattern, patterns) {
+        // Patterns which don't compile never matched anything in the page
+        // either, so just leave them out
+        QRegularExpression expression(pattern);
+        if (!expression.isValid()) {
+            qWarning() << "Ignoring invalid url pattern" << pattern << ":" << expression.errorString();
+            continue;
+        }
+
+        expressions.append(expression);
+
+        if (hasBackreference(pattern))
+            mSeparateExpressions.append(expression);
+        else
+            alternatives.append(QString("(?:%1)").arg(pattern));
+    }
+
+    if (expressions.isEmpty())
+        return;
+
+    mEmpty = false;
+
+    if (alternatives.isEmpty())
+        return;
+
+    mExpression.setPattern(alternatives.join("|"));
+    mExpression.setPatternOptions(QRegularExpression::OptimizeOnFirstUsageOption);
+
+    // Patterns fine on their own can still clash once joined, for example
+    // by using the same group name
+    if (!mExpression.isValid()) {
+        mExpression = QRegularExpression();
+        mSeparateExpressions = expressions;
+    }
+}
+
+bool UrlPatternMatcher::isEmpty() const
+{
+    return mEmpty;
+}
+
+bool UrlPatternMatcher::matches(const QString &url)
+{
+    if (mEmpty)
+        return false;
+
+    QHash<QString, bool>::const_iterator cached = mCache.constFind(url);
+    if (cached != mCache.constEnd())
+        return cached.value();
+
+    bool result = !mExpression.pattern().isEmpty() && mExpression.match(url).hasMatch();
+
+    for (int n = 0; !result && n < mSeparateExpressions.count(); n++)
+        result = mSeparateExpressions.at(n).match(url).hasMatch();
+
+    if (mCache.count() >= MAX_CACHED_RESULTS)
+        mCache.clear();
+
+    mCache.insert(url, result);
+
+    return result;
+}
+
+} // namespace luna
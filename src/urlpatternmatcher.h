@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef URLPATTERNMATCHER_H
+#define URLPATTERNMATCHER_H
+
+#include <QHash>
+#include <QList>
+#include <QRegularExpression>
+#include <QStringList>
+
+namespace luna
+{
+
+/**
+ * Matches urls against the urlsAllowed patterns of an application manifest.
+ * All patterns are compiled once into a single regular expression and the
+ * results for recently checked urls are cached. Patterns with backreferences
+ * are kept apart as joining them would renumber their groups.
+ */
+class UrlPatternMatcher
+{
+public:
+    explicit UrlPatternMatcher(const QStringList &patterns = QStringList());
+
+    bool isEmpty() const;
+    bool matches(const QString &url);
+
+private:
+    QRegularExpression mExpression;
+    QList<QRegularExpression> mSeparateExpressions;
+    bool mEmpty;
+    QHash<QString, bool> mCache;
+};
+
+} // namespace luna
+
+#endif // URLPATTERNMATCHER_H
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QDebug>
+#include <QStringList>
+#include <QUrl>
+
+#include "useragentoverrides.h"
+
+namespace luna
+{
+
+UserAgentOverrides* UserAgentOverrides::instance()
+{
+    static UserAgentOverrides* instance = 0;
+
+    if (!instance)
+        instance = new UserAgentOverrides();
+
+    return instance;
+}
+
+UserAgentOverrides::UserAgentOverrides() :
+    mLoaded(false)
+{
+}
+
+UserAgentOverrides::~UserAgentOverrides()
+{
+}
+
+bool UserAgentOverrides::loaded() const
+{
+    return mLoaded;
+}
+
+/**
+ * Takes a map of domain names to the final user agent string to use for it.
+ */
+void UserAgentOverrides::load(const QVariantMap &overrides)
+{
+    if (mLoaded)
+        return;
+
+    QVariantMap::const_iterator iter;
+    for (iter = overrides.constBegin(); iter != overrides.constEnd(); ++iter) {
+        QStringList labels = iter.key().toLower().split('.');
+
+        Node *node = &mRoot;
+        for (int n = labels.count() - 1; n >= 0; n--) {
+            Node *child = node->children.value(labels.at(n));
+            if (!child) {
+                child = new Node;
+                node->children.insert(labels.at(n), child);
+            }
+            node = child;
+        }
+
+        node->hasUserAgent = true;
+        node->userAgent = iter.value().toString();
+    }
+
+    mLoaded = true;
+    emit loadedChanged();
+
+    qDebug() << "Loaded" << overrides.count() << "user agent overrides";
+}
+
+QString UserAgentOverrides::lookup(const QString &url, const QString &defaultUserAgent) const
+{
+    QString host = QUrl(url).host().toLower();
+    if (host.isEmpty())
+        return defaultUserAgent;
+
+    // Walk from the top level domain inwards; the deepest node with an
+    // override is the most specific match for the host
+    const Node *node = &mRoot;
+    const QString *userAgent = &defaultUserAgent;
+
+    int end = host.length();
+    while (end > 0) {
+        int start = host.lastIndexOf('.', end - 1) + 1;
+
+        node = node->children.value(host.mid(start, end - start));
+        if (!node)
+            break;
+
+        if (node->hasUserAgent)
+            userAgent = &node->userAgent;
+
+        end = start - 1;
+    }
+
+    return *userAgent;
+}
+
+} // namespace luna
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2014 Simon Busch <morphis@gravedo.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef USERAGENTOVERRIDES_H
+#define USERAGENTOVERRIDES_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <QVariantMap>
+
+namespace luna
+{
+
+/**
+ * Per domain user agent overrides stored in a trie of reversed domain labels
+ * ("com" -> "google" -> "plus"). The table is loaded once per process with
+ * the final user agent string for every domain so a lookup doesn't need to
+ * build any strings.
+ */
+class UserAgentOverrides : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool loaded READ loaded NOTIFY loadedChanged)
+
+public:
+    static UserAgentOverrides* instance();
+    ~UserAgentOverrides();
+
+    bool loaded() const;
+
+    Q_INVOKABLE void load(const QVariantMap &overrides);
+    Q_INVOKABLE QString lookup(const QString &url, const QString &defaultUserAgent) const;
+
+Q_SIGNALS:
+    void loadedChanged();
+
+private:
+    struct Node
+    {
+        Node() : hasUserAgent(false) { }
+        ~Node() { qDeleteAll(children); }
+
+        QHash<QString, Node*> children;
+        bool hasUserAgent;
+        QString userAgent;
+    };
+
+    UserAgentOverrides();
+
+    Node mRoot;
+    bool mLoaded;
+};
+
+} // namespace luna
+
+#endif // USERAGENTOVERRIDES_H
@@ -25,3 +25,8 @@ QString jsonObjectToString(const QJsonObject &object)
     doc.setObject(object);
     return QString(doc.toJson());
 }
+
+QString launcherCachePath(const QString &name)
+{
+    return QString("%1/webapp-launcher/%2").arg(QString(qgetenv("XDG_CACHE_HOME"))).arg(name);
+}
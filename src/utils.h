@@ -23,4 +23,7 @@ class QJsonObject;
 
 QString jsonObjectToString(const QJsonObject &object);
 
+// Path of the given file or directory below our directory in XDG_CACHE_HOME
+QString launcherCachePath(const QString &name);
+
 #endif // UTILS_H
@@ -23,13 +23,18 @@
 #include "applicationdescription.h"
 #include "webapplauncher.h"
 #include "webapplication.h"
+#include "launcherservice.h"
+#include "eventtrace.h"
+#include "utils.h"
 
 namespace luna
 {
 
 WebAppLauncher::WebAppLauncher(int &argc, char **argv)
     : QGuiApplication(argc, argv),
-      mLaunchedApp(0)
+      mLaunchedApp(0),
+      mService(0),
+      mLightweightHeadless(false)
 {
     setApplicationName("WebAppLauncher");
 
@@ -53,6 +58,8 @@ WebAppLauncher::WebAppLauncher(int &argc, char **argv)
 WebAppLauncher::~WebAppLauncher()
 {
     onAboutToQuit();
+
+    delete mService;
 }
 
 bool WebAppLauncher::validateApplication(const ApplicationDescription& desc)
@@ -69,6 +76,16 @@ bool WebAppLauncher::validateApplication(const ApplicationDescription& desc)
     return true;
 }
 
+void WebAppLauncher::setLightweightHeadless(bool enabled)
+{
+    mLightweightHeadless = enabled;
+}
+
+bool WebAppLauncher::lightweightHeadless() const
+{
+    return mLightweightHeadless;
+}
+
 void WebAppLauncher::launchApp(const QString &manifestPath, const QString &parameters)
 {
     QFile manifestFile(manifestPath);
@@ -95,6 +112,12 @@ void WebAppLauncher::launchApp(const QString &manifestPath, const QString &param
     // each application are separated and remain after the application was stopped.
     QCoreApplication::setApplicationName(desc.id());
 
+    EventTrace::installDumpHandlers(launcherCachePath("traces"),
+                                    QString("%1-%2").arg(desc.id()).arg(applicationPid()));
+
+    // Lets tools like luna-send inspect the running launcher
+    mService = new LauncherService(desc.id());
+
     QQuickWebViewExperimental::setFlickableViewportEnabled(desc.flickable());
 
     QString processId = QString("%0").arg(applicationPid());
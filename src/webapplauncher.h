@@ -31,6 +31,7 @@ namespace luna
 {
 
 class ApplicationDescription;
+class LauncherService;
 class WebApplication;
 
 class WebAppLauncher : public QGuiApplication
@@ -43,13 +44,18 @@ public:
 
     void launchApp(const QString &manifestPath, const QString &parameters);
 
+    void setLightweightHeadless(bool enabled);
+    bool lightweightHeadless() const;
+
 private Q_SLOTS:
     void onApplicationWindowClosed();
     void onAboutToQuit();
 
 private:
     WebApplication *mLaunchedApp;
+    LauncherService *mService;
     QStringList mAllowedHeadlessApps;
+    bool mLightweightHeadless;
 
     bool validateApplication(const ApplicationDescription& desc);
 };
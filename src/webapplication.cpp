@@ -16,9 +16,12 @@
  */
 
 #include <QDebug>
+#include <QCoreApplication>
 #include <QQmlContext>
-#include <QJsonObject>
+#include <QPixmapCache>
 #include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
 
 #include <QtWebKit/private/qquickwebview_p.h>
 #ifndef WITH_UNMODIFIED_QTWEBKI
@@ -33,6 +36,11 @@
 #include "webapplication.h"
 #include "webapplicationwindow.h"
 #include "webapplicationplugin.h"
+#include "jsonreader.h"
+#include "resourcepathvalidator.h"
+#include "sharedextensionenvironment.h"
+
+#include "extensions/lunaservicemgr.h"
 
 #include <Settings.h>
 
@@ -45,80 +53,11 @@ namespace luna
 {
 
 struct webos_application_event_handlers event_handlers = {
-    .activate = NULL,
-    .deactivate = NULL,
-    .suspend = NULL,
+    .activate = WebApplication::activate_cb,
+    .deactivate = WebApplication::deactivate_cb,
+    .suspend = WebApplication::suspend_cb,
     .relaunch = WebApplication::relaunch_cb,
-    .lowmemory = NULL
-};
-
-class ResourcePathValidator
-{
-public:
-    static ResourcePathValidator& instance()
-    {
-        static ResourcePathValidator instance;
-        return instance;
-    }
-
-    bool validate(const QString &path, bool privileged)
-    {
-        if (findPathInList(mAllowedTargetPaths, path))
-            return true;
-        if (privileged && findPathInList(mPrivilegedAppPaths, path))
-            return true;
-        if (!privileged && findPathInList(mUnprivilegedAppPaths, path))
-            return true;
-
-        return false;
-    }
-
-private:
-    ResourcePathValidator()
-    {
-        // NOTE: below set of paths are taken from the configuration set in the webkit used in
-        // webOS 3.0.5. See http://downloads.help.palm.com/opensource/3.0.5/webcore-patch.gz
-
-        // paths allowed for every app
-        mAllowedTargetPaths << "/usr/palm/frameworks";
-        mAllowedTargetPaths << "/media/internal";
-        mAllowedTargetPaths << "/usr/lib/luna/luna-media";
-        mAllowedTargetPaths << "/var/luna/files";
-        mAllowedTargetPaths << "/var/luna/data/extractfs";
-        mAllowedTargetPaths << "/var/luna/data/im-avatars";
-        mAllowedTargetPaths <<  "/usr/palm/applications/com.palm.app.contacts/sharedWidgets/";
-        mAllowedTargetPaths << "/usr/palm/sysmgr/";
-        mAllowedTargetPaths << "/usr/palm/public";
-        mAllowedTargetPaths << "/var/file-cache/";
-        mAllowedTargetPaths << "/usr/lib/luna/system/luna-systemui/images/";
-        mAllowedTargetPaths << "/usr/lib/luna/system/luna-systemui/app/FilePicker";
-
-        // paths only allowed for privileged apps
-        mPrivilegedAppPaths << "/usr/lib/luna/system/";   // system ui apps
-        mPrivilegedAppPaths << "/usr/palm/applications/";  // Palm apps
-        mPrivilegedAppPaths << "/var/usr/palm/applications/com.palm.";  // privileged apps like facebook
-        mPrivilegedAppPaths << "/media/cryptofs/apps/usr/palm/applications/com.palm.";  // privileged 3rd party apps
-        mPrivilegedAppPaths << "/usr/palm/sysmgr/";
-        mPrivilegedAppPaths << "/var/usr/palm/applications/com/palm/";
-        mPrivilegedAppPaths << "/media/cryptofs/apps/usr/palm/applications/com/palm/";
-
-        // additional paths allowed for unprivileged apps
-        mUnprivilegedAppPaths << "/var/usr/palm/applications/";
-        mUnprivilegedAppPaths << "/media/cryptofs/apps/usr/palm/applications/";
-    }
-
-    bool findPathInList(const QStringList &list, const QString &path)
-    {
-        Q_FOREACH(QString item, list) {
-            if (path.startsWith(item))
-                return true;
-        }
-        return false;
-    }
-
-    QStringList mAllowedTargetPaths;
-    QStringList mPrivilegedAppPaths;
-    QStringList mUnprivilegedAppPaths;
+    .lowmemory = WebApplication::lowmemory_cb
 };
 
 WebApplication::WebApplication(WebAppLauncher *launcher, const QUrl& url, const QString& windowType,
@@ -134,19 +73,52 @@ WebApplication::WebApplication(WebAppLauncher *launcher, const QUrl& url, const
     mLaunchedAtBoot(false),
     mPrivileged(false),
     mPlugin(0),
-    mActivity(mIdentifier, desc.id(), processId)
+    mActivity(mIdentifier, desc.id(), processId),
+    mMemoryPressureMonitor(this),
+    mMemoryAccounting(this),
+    mMemoryPressureTier(MemoryPressureNone),
+    mMemoryPressureResetTimer(this),
+    mMemoryTierSettleTimer(this),
+    mStageReadyHistory(desc.id()),
+    mUrlsAllowed(desc.urlsAllowed()),
+    mOfflineCache(0),
+    mSharedExtensionEnvironment(0)
 {
     webos_application_init(desc.id().toUtf8().constData(), &event_handlers, this);
     webos_application_attach(g_main_loop_new(g_main_context_default(), TRUE));
 
     loadPlugin();
 
+    // When memory pressure calms down for a while start over with the
+    // cheapest response again
+    mMemoryPressureResetTimer.setSingleShot(true);
+    mMemoryPressureResetTimer.setInterval(30000);
+    connect(&mMemoryPressureResetTimer, SIGNAL(timeout()), this, SLOT(onMemoryPressureReset()));
+
+    // Most of what a tier releases is freed later and by the web processes
+    // so what it gained is only measured after a moment
+    mMemoryTierSettleTimer.setSingleShot(true);
+    mMemoryTierSettleTimer.setInterval(3000);
+    connect(&mMemoryTierSettleTimer, SIGNAL(timeout()), this, SLOT(onMemoryTierSettled()));
+
+    // The kernel's memory pressure information is used in addition to the
+    // lowmemory event as not every system sends the latter
+    connect(&mMemoryPressureMonitor, SIGNAL(pressureDetected()), this, SLOT(onMemoryPressure()));
+    mMemoryPressureMonitor.start();
+
+    mMemoryAccounting.start();
+
     // Only system applications with a specific id prefix are privileged to access
     // the private luna bus
     if (mDescription.id().startsWith("org.webosports") || mDescription.id().startsWith("com.palm") ||
         mDescription.id().startsWith("org.webosinternals"))
         mPrivileged = true;
 
+    // Remote applications which can't do anything without network get a
+    // local copy of their entry page to show when we're offline
+    if (hasRemoteEntryPoint() && internetConnectivityRequired())
+        mOfflineCache = new OfflineCache(id(), url, this);
+
     mMainWindow = new WebApplicationWindow(this, url, windowType,
             QSize(Settings::LunaSettings()->displayWidth, Settings::LunaSettings()->displayHeight),
             mDescription.headless());
@@ -155,10 +127,19 @@ WebApplication::WebApplication(WebAppLauncher *launcher, const QUrl& url, const
 
     const std::set<std::string> appsToLaunchAtBoot = Settings::LunaSettings()->appsToLaunchAtBoot;
     mLaunchedAtBoot = (appsToLaunchAtBoot.find(id().toStdString()) != appsToLaunchAtBoot.end());
+
+    // Applications launched at boot are started before most services are registered
+    // on the bus. Hold their service calls back until the target service is up
+    // rather than letting them fail and have the app retry them in a loop. Once
+    // boot is over calls fail right away again, also for apps launched later.
+    if (mLaunchedAtBoot)
+        LunaServiceManager::instance()->holdCallsToUnavailableServices(30000);
 }
 
 WebApplication::~WebApplication()
 {
+    // Shared extensions are torn down before the plugin they come from
+    delete mSharedExtensionEnvironment;
 }
 
 void WebApplication::relaunch_cb(const char *parameters, void *user_data)
@@ -168,22 +149,43 @@ void WebApplication::relaunch_cb(const char *parameters, void *user_data)
     webapp->relaunch(params);
 }
 
+void WebApplication::activate_cb(void *user_data)
+{
+    WebApplication *webapp = static_cast<WebApplication*>(user_data);
+    webapp->activate();
+}
+
+void WebApplication::deactivate_cb(void *user_data)
+{
+    WebApplication *webapp = static_cast<WebApplication*>(user_data);
+    webapp->deactivate();
+}
+
+void WebApplication::suspend_cb(void *user_data)
+{
+    WebApplication *webapp = static_cast<WebApplication*>(user_data);
+    webapp->suspend();
+}
+
+void WebApplication::lowmemory_cb(void *user_data)
+{
+    WebApplication *webapp = static_cast<WebApplication*>(user_data);
+    webapp->handleLowMemory();
+}
+
 void WebApplication::loadPlugin()
 {
+    if (mDescription.pluginName().isEmpty())
+        return;
+
     QFileInfo pluginPath(QString("%1/plugins/%2")
                          .arg(mDescription.basePath())
                          .arg(mDescription.pluginName()));
 
-    if (pluginPath.absoluteFilePath().length() == 0 || !pluginPath.exists())
-        return;
-
-    mPlugin = new WebApplicationPlugin(pluginPath);
-    if (!mPlugin->load()) {
-        delete mPlugin;
-        mPlugin = 0;
-    }
-
-    qDebug() << "Plugin" << mDescription.pluginName() << "successfully loaded";
+    // The library is loaded in parallel to setting up the main window; its
+    // extensions are created once the page needs them
+    mPlugin = new WebApplicationPlugin(pluginPath, this);
+    mPlugin->loadAsync();
 }
 
 void WebApplication::changeActivityFocus(bool focus)
@@ -192,6 +194,14 @@ void WebApplication::changeActivityFocus(bool focus)
         mActivity.focus();
     else
         mActivity.unfocus();
+
+    if (mPlugin)
+        mPlugin->focusChanged(focus);
+
+    if (mSharedExtensionEnvironment)
+        mSharedExtensionEnvironment->runLifecycleHook([focus](BaseExtension *extension) {
+            extension->focusChanged(focus);
+        });
 }
 
 void WebApplication::relaunch(const QString &parameters)
@@ -204,6 +214,214 @@ void WebApplication::relaunch(const QString &parameters)
     mMainWindow->executeScript(QString("Mojo.relaunch();"));
 }
 
+void WebApplication::activate()
+{
+    qDebug() << __PRETTY_FUNCTION__ << "Activating application" << mDescription.id();
+
+    mMemoryAccounting.start();
+
+    if (mMainWindow)
+        mMainWindow->resume();
+
+    foreach(WebApplicationWindow *child, mChildWindows)
+        child->resume();
+
+    if (mPlugin)
+        mPlugin->resumed();
+
+    if (mSharedExtensionEnvironment)
+        mSharedExtensionEnvironment->runLifecycleHook([](BaseExtension *extension) {
+            extension->resumed();
+        });
+}
+
+void WebApplication::deactivate()
+{
+    qDebug() << __PRETTY_FUNCTION__ << "Deactivating application" << mDescription.id();
+
+    // Being deactivated means we're in the background so throttle ourself the
+    // same way as when being suspended
+    suspend();
+}
+
+void WebApplication::suspend()
+{
+    qDebug() << __PRETTY_FUNCTION__ << "Suspending application" << mDescription.id();
+
+    // Nothing to learn from sampling an app which doesn't run
+    mMemoryAccounting.stop();
+
+    if (mMainWindow)
+        mMainWindow->suspend();
+
+    foreach(WebApplicationWindow *child, mChildWindows)
+        child->suspend();
+
+    if (mPlugin)
+        mPlugin->suspended();
+
+    if (mSharedExtensionEnvironment)
+        mSharedExtensionEnvironment->runLifecycleHook([](BaseExtension *extension) {
+            extension->suspended();
+        });
+}
+
+void WebApplication::onMemoryPressure()
+{
+    // The PSI trigger fires repeatedly while the pressure lasts, only escalate
+    // once the previous response had some time to take effect
+    if (mMemoryPressureResetTimer.isActive() &&
+        mMemoryPressureResetTimer.remainingTime() > mMemoryPressureResetTimer.interval() - 5000)
+        return;
+
+    handleLowMemory();
+}
+
+void WebApplication::onMemoryPressureReset()
+{
+    qDebug() << __PRETTY_FUNCTION__ << "Memory pressure is gone for application" << mDescription.id();
+    mMemoryPressureTier = MemoryPressureNone;
+
+    qWarning("Memory usage of application %s after low memory: %s", mDescription.id().toUtf8().constData(),
+             QJsonDocument(mMemoryAccounting.sample()).toJson(QJsonDocument::Compact).constData());
+}
+
+void WebApplication::handleLowMemory()
+{
+    if (mMemoryPressureTier < MemoryPressureCloseChildWindows)
+        mMemoryPressureTier++;
+
+    mMemoryPressureResetTimer.start();
+
+    QList<WebApplicationWindow*> windows = this->windows();
+
+    // A tier following before the previous one settled still gets its
+    // share reported
+    if (mMemoryTierSettleTimer.isActive()) {
+        mMemoryTierSettleTimer.stop();
+        onMemoryTierSettled();
+    }
+
+    mMemoryBeforeTier = sampleProcessMemory();
+
+    // Tell which windows are the big ones before anything gets released
+    if (mMemoryPressureTier == MemoryPressureFlushCaches)
+        qWarning("Memory usage of application %s: %s", mDescription.id().toUtf8().constData(),
+                 QJsonDocument(mMemoryAccounting.sample()).toJson(QJsonDocument::Compact).constData());
+
+    // Plugins get the chance to drop their caches first; windows might be
+    // gone once we're done
+    BaseExtension::MemoryPressureLevel level = BaseExtension::CriticalMemoryPressure;
+    if (mMemoryPressureTier == MemoryPressureFlushCaches)
+        level = BaseExtension::LowMemoryPressure;
+    else if (mMemoryPressureTier == MemoryPressureReleaseHiddenWindows)
+        level = BaseExtension::MediumMemoryPressure;
+
+    if (mPlugin)
+        mPlugin->memoryPressure(level);
+
+    if (mSharedExtensionEnvironment)
+        mSharedExtensionEnvironment->runLifecycleHook([level](BaseExtension *extension) {
+            extension->memoryPressure(level);
+        });
+
+    foreach(WebApplicationWindow *window, windows)
+        window->notifyMemoryPressure(level);
+
+    QString action;
+
+    switch (mMemoryPressureTier) {
+    case MemoryPressureFlushCaches:
+        action = "flushing resource and QML caches";
+        QPixmapCache::clear();
+        foreach(WebApplicationWindow *window, windows)
+            window->releaseCaches();
+        break;
+    case MemoryPressureReleaseHiddenWindows:
+        action = "releasing scene graph resources of hidden windows";
+        foreach(WebApplicationWindow *window, windows)
+            window->releaseSceneGraphResources();
+        break;
+    case MemoryPressurePurgeWebContent:
+        action = "asking web content to free memory";
+        foreach(WebApplicationWindow *window, windows)
+            window->purgeWebContent();
+        break;
+    case MemoryPressureCloseChildWindows:
+        action = "closing inactive child windows";
+        foreach(WebApplicationWindow *child, mChildWindows) {
+            if (!child->keepAlive() && !child->active())
+                child->close();
+        }
+        break;
+    }
+
+    qWarning("Low memory for application %s: %s", mDescription.id().toUtf8().constData(),
+             action.toUtf8().constData());
+
+    mMemoryTierAction = action;
+    mMemoryTierSettleTimer.start();
+}
+
+QMap<qint64, MemoryAccounting::ProcessMemory> WebApplication::sampleProcessMemory() const
+{
+    QMap<qint64, MemoryAccounting::ProcessMemory> memory;
+
+    qint64 launcherPid = QCoreApplication::applicationPid();
+    memory.insert(launcherPid, MemoryAccounting::processMemory(launcherPid));
+
+    foreach(WebApplicationWindow *window, windows()) {
+        qint64 pid = window->webProcessPid();
+        if (pid > 0 && !memory.contains(pid))
+            memory.insert(pid, MemoryAccounting::processMemory(pid));
+    }
+
+    return memory;
+}
+
+void WebApplication::onMemoryTierSettled()
+{
+    qint64 launcherPid = QCoreApplication::applicationPid();
+    QMap<qint64, MemoryAccounting::ProcessMemory> after = sampleProcessMemory();
+
+    QJsonObject launcher;
+    QJsonArray webProcesses;
+
+    // Processes gone in between, like the ones of closed windows, count as
+    // having released everything
+    QMap<qint64, MemoryAccounting::ProcessMemory>::const_iterator iter;
+    for (iter = mMemoryBeforeTier.constBegin(); iter != mMemoryBeforeTier.constEnd(); ++iter) {
+        const MemoryAccounting::ProcessMemory &before = iter.value();
+        if (!before.isValid())
+            continue;
+
+        MemoryAccounting::ProcessMemory now = after.value(iter.key());
+        qint64 rssAfter = now.isValid() ? now.rss : 0;
+        qint64 pssAfter = now.isValid() ? now.pss : 0;
+
+        QJsonObject delta;
+        delta.insert("pid", (double) iter.key());
+        delta.insert("rss", (double) (rssAfter - before.rss));
+        if (before.pss >= 0 && pssAfter >= 0)
+            delta.insert("pss", (double) (pssAfter - before.pss));
+
+        if (iter.key() == launcherPid)
+            launcher = delta;
+        else
+            webProcesses.append(delta);
+    }
+
+    QJsonObject usage;
+    usage.insert("launcher", launcher);
+    usage.insert("webProcesses", webProcesses);
+
+    qWarning("Memory change of application %s after %s (kB): %s", mDescription.id().toUtf8().constData(),
+             mMemoryTierAction.toUtf8().constData(),
+             QJsonDocument(usage).toJson(QJsonDocument::Compact).constData());
+
+    mMemoryBeforeTier.clear();
+}
+
 #ifndef WITH_UNMODIFIED_QTWEBKIT
 
 void WebApplication::createWindow(QWebNewPageRequest *request)
@@ -224,8 +442,8 @@ void WebApplication::createWindow(QWebNewPageRequest *request)
     // check if we got supplied with a different window type
     if (windowFeatures.contains("attributes")) {
         QString attributes = windowFeatures["attributes"].toString();
-        QJsonDocument document = QJsonDocument::fromJson(attributes.toUtf8());
-        QString windowTypeAttrib = document.object().value("window").toString();
+        JsonReader reader(attributes.toUtf8());
+        QString windowTypeAttrib = reader.stringValue("window");
         if (windowTypeAttrib.length() > 0)
             windowType = windowTypeAttrib;
     }
@@ -269,12 +487,14 @@ void WebApplication::windowClosed()
                      << "were closed so closing the main window too";
 
             delete mMainWindow;
+            mMainWindow = 0;
             emit closed();
         }
     }
     else if (window == mMainWindow) {
         // the main window was closed so close all child windows too
         delete mMainWindow;
+        mMainWindow = 0;
 
         qDebug() << "The main window of app " << id()
                  << "was closed, so closing all child windows too";
@@ -292,6 +512,15 @@ bool WebApplication::validateResourcePath(const QString &path)
     return ResourcePathValidator::instance().validate(path, mPrivileged);
 }
 
+bool WebApplication::isUrlAllowed(const QString &url)
+{
+    // Without any restrictions in the manifest every url is allowed
+    if (mDescription.urlsAllowed().isEmpty())
+        return true;
+
+    return mUrlsAllowed.matches(url);
+}
+
 QString WebApplication::id() const
 {
     return mDescription.id();
@@ -327,6 +556,11 @@ bool WebApplication::headless() const
     return mDescription.headless();
 }
 
+bool WebApplication::lightweightHeadless() const
+{
+    return headless() && mLauncher->lightweightHeadless();
+}
+
 bool WebApplication::privileged() const
 {
     return mPrivileged;
@@ -337,6 +571,42 @@ WebApplicationPlugin* WebApplication::plugin() const
     return mPlugin;
 }
 
+StageReadyHistory* WebApplication::stageReadyHistory()
+{
+    return &mStageReadyHistory;
+}
+
+OfflineCache* WebApplication::offlineCache() const
+{
+    return mOfflineCache;
+}
+
+SharedExtensionEnvironment* WebApplication::sharedExtensionEnvironment()
+{
+    if (!mSharedExtensionEnvironment && mPlugin)
+        mSharedExtensionEnvironment = new SharedExtensionEnvironment(mPlugin, this);
+
+    return mSharedExtensionEnvironment;
+}
+
+QList<WebApplicationWindow*> WebApplication::windows() const
+{
+    QList<WebApplicationWindow*> windows = mChildWindows;
+    if (mMainWindow)
+        windows.prepend(mMainWindow);
+    return windows;
+}
+
+bool WebApplication::isMainWindow(const WebApplicationWindow *window) const
+{
+    return window == mMainWindow;
+}
+
+bool WebApplication::hasMainWindow() const
+{
+    return mMainWindow != 0;
+}
+
 bool WebApplication::internetConnectivityRequired() const
 {
     return mDescription.internetConnectivityRequired();
@@ -367,4 +637,9 @@ bool WebApplication::loadingAnimationDisabled() const
     return mDescription.loadingAnimationDisabled();
 }
 
+bool WebApplication::streamServiceResponses() const
+{
+    return mDescription.streamServiceResponses();
+}
+
 } // namespace luna
@@ -20,12 +20,18 @@
 
 #include <QQuickView>
 #include <QMap>
+#include <QTimer>
 #ifndef WITH_UNMODIFIED_QTWEBKIT
 #include <QtWebKit/private/qwebnewpagerequest_p.h>
 #endif
 
 #include "applicationdescription.h"
 #include "activity.h"
+#include "memorypressuremonitor.h"
+#include "memoryaccounting.h"
+#include "stagereadyhistory.h"
+#include "urlpatternmatcher.h"
+#include "offlinecache.h"
 
 namespace luna
 {
@@ -34,6 +40,7 @@ class WebAppLauncher;
 class BaseExtension;
 class WebApplicationWindow;
 class WebApplicationPlugin;
+class SharedExtensionEnvironment;
 
 class WebApplication : public QObject
 {
@@ -66,20 +73,39 @@ public:
     int activityId() const;
     QString parameters() const;
     bool headless() const;
+    bool lightweightHeadless() const;
     bool privileged() const;
     bool internetConnectivityRequired() const;
     QStringList urlsAllowed() const;
     bool hasRemoteEntryPoint() const;
     QString userAgent() const;
     bool loadingAnimationDisabled() const;
+    bool streamServiceResponses() const;
 
     WebApplicationPlugin* plugin() const;
+    StageReadyHistory* stageReadyHistory();
+    OfflineCache* offlineCache() const;
+    SharedExtensionEnvironment* sharedExtensionEnvironment();
+    QList<WebApplicationWindow*> windows() const;
+    bool isMainWindow(const WebApplicationWindow *window) const;
+    bool hasMainWindow() const;
 
     void changeActivityFocus(bool focus);
 
     bool validateResourcePath(const QString& path);
 
+    Q_INVOKABLE bool isUrlAllowed(const QString &url);
+
+    static void activate_cb(void *user_data);
+    static void deactivate_cb(void *user_data);
+    static void suspend_cb(void *user_data);
+    static void lowmemory_cb(void *user_data);
     static void relaunch_cb(const char *parameters, void *user_data);
+
+    void activate();
+    void deactivate();
+    void suspend();
+    void handleLowMemory();
     void relaunch(const QString &parameters);
 
 #ifndef WITH_UNMODIFIED_QTWEBKIT
@@ -94,7 +120,20 @@ Q_SIGNALS:
 public Q_SLOTS:
     void windowClosed();
 
+private Q_SLOTS:
+    void onMemoryPressure();
+    void onMemoryPressureReset();
+    void onMemoryTierSettled();
+
 private:
+    enum MemoryPressureTier {
+        MemoryPressureNone = 0,
+        MemoryPressureFlushCaches,
+        MemoryPressureReleaseHiddenWindows,
+        MemoryPressurePurgeWebContent,
+        MemoryPressureCloseChildWindows
+    };
+
     WebAppLauncher *mLauncher;
     ApplicationDescription mDescription;
     QString mProcessId;
@@ -106,8 +145,20 @@ private:
     bool mPrivileged;
     WebApplicationPlugin* mPlugin;
     Activity mActivity;
+    MemoryPressureMonitor mMemoryPressureMonitor;
+    MemoryAccounting mMemoryAccounting;
+    int mMemoryPressureTier;
+    QTimer mMemoryPressureResetTimer;
+    QTimer mMemoryTierSettleTimer;
+    QString mMemoryTierAction;
+    QMap<qint64, MemoryAccounting::ProcessMemory> mMemoryBeforeTier;
+    StageReadyHistory mStageReadyHistory;
+    UrlPatternMatcher mUrlsAllowed;
+    OfflineCache *mOfflineCache;
+    SharedExtensionEnvironment *mSharedExtensionEnvironment;
 
     void loadPlugin();
+    QMap<qint64, MemoryAccounting::ProcessMemory> sampleProcessMemory() const;
 };
 
 } // namespace luna
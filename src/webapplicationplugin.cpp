@@ -16,38 +16,281 @@
  */
 
 #include <QDebug>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QRunnable>
+#include <QSettings>
+#include <QThreadPool>
 
 #include "webapplicationplugin.h"
+#include "utils.h"
+
+#define PLUGIN_METADATA_CACHE_VERSION 3
 
 namespace luna
 {
 
+/**
+ * Remembers per plugin path whether the plugin implements our interface and
+ * the lifetime of its extensions so the metadata doesn't need to be scanned
+ * on every launch. Entries are only valid as long as the modification time
+ * of the plugin matches.
+ */
+class PluginMetaDataCache
+{
+public:
+    PluginMetaDataCache() :
+        mSettings(launcherCachePath("plugins.ini"), QSettings::IniFormat)
+    {
+    }
+
+    bool lookup(const QFileInfo &path, bool &implementsInterface, bool &applicationScoped)
+    {
+        mSettings.beginGroup(groupName(path));
+        bool valid = mSettings.value("version").toInt() == PLUGIN_METADATA_CACHE_VERSION &&
+                     mSettings.value("mtime").toLongLong() == path.lastModified().toMSecsSinceEpoch() &&
+                     mSettings.value("size").toLongLong() == path.size();
+        implementsInterface = mSettings.value("implementsInterface", false).toBool();
+        applicationScoped = mSettings.value("applicationScoped", false).toBool();
+        mSettings.endGroup();
+        return valid;
+    }
+
+    void store(const QFileInfo &path, bool implementsInterface, bool applicationScoped)
+    {
+        mSettings.beginGroup(groupName(path));
+        mSettings.setValue("version", PLUGIN_METADATA_CACHE_VERSION);
+        mSettings.setValue("mtime", path.lastModified().toMSecsSinceEpoch());
+        mSettings.setValue("size", path.size());
+        mSettings.setValue("implementsInterface", implementsInterface);
+        mSettings.setValue("applicationScoped", applicationScoped);
+        mSettings.endGroup();
+    }
+
+private:
+    QString groupName(const QFileInfo &path) const
+    {
+        // slashes would be taken as nested groups
+        QString name = path.absoluteFilePath();
+        return name.replace('/', '_');
+    }
+
+    QSettings mSettings;
+};
+
+class PluginLoadTask : public QRunnable
+{
+public:
+    PluginLoadTask(WebApplicationPlugin *plugin) :
+        mPlugin(plugin)
+    {
+    }
+
+    void run()
+    {
+        mPlugin->loadLibrary();
+    }
+
+private:
+    WebApplicationPlugin *mPlugin;
+};
+
 WebApplicationPlugin::WebApplicationPlugin(const QFileInfo &path, QObject *parent) :
     QObject(parent),
-    mPath(path)
+    mInstance(0),
+    mLifecycle(0),
+    mPath(path),
+    mLoadState(LoadNotStarted),
+    mLibraryLoaded(false),
+    mInstanceCreated(false),
+    mApplicationScoped(false),
+    mLoadTime(0)
+{
+}
+
+WebApplicationPlugin::~WebApplicationPlugin()
+{
+    if (mLifecycle)
+        mLifecycle->teardown();
+
+    // don't pull the loader away under a still running load task
+    QMutexLocker locker(&mLoadMutex);
+    while (mLoadState == LoadRunning)
+        mLoadCondition.wait(&mLoadMutex);
+}
+
+/**
+ * Starts mapping the plugin library on a worker thread. Anything needing the
+ * plugin will wait for it to finish.
+ */
+void WebApplicationPlugin::loadAsync()
 {
+    QMutexLocker locker(&mLoadMutex);
+    if (mLoadState != LoadNotStarted)
+        return;
+
+    mLoadState = LoadRunning;
+    QThreadPool::globalInstance()->start(new PluginLoadTask(this));
 }
 
 bool WebApplicationPlugin::load()
 {
-    mLoader.setFileName(mPath.filePath());
-    if (Q_UNLIKELY(!mLoader.load())) {
-        qWarning() << "Failed to load application plugin: " << mLoader.errorString();
-        return false;
+    return waitForLoaded() && checkInterface();
+}
+
+void WebApplicationPlugin::loadLibrary()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    bool libraryLoaded = false;
+
+    if (mPath.exists()) {
+        PluginMetaDataCache cache;
+        bool implementsInterface = false;
+        bool applicationScoped = false;
+
+        mLoader.setFileName(mPath.filePath());
+
+        if (!cache.lookup(mPath, implementsInterface, applicationScoped)) {
+            QJsonObject metaData = mLoader.metaData();
+            // Plugins with lifecycle hooks declare the lifecycle interface instead
+            QString iid = metaData.value("IID").toString();
+            implementsInterface = iid == QLatin1String(qobject_interface_iid<ApplicationPlugin*>()) ||
+                    iid == QLatin1String(qobject_interface_iid<LifecycleApplicationPlugin*>());
+            // Plugins opt in to share one set of extensions between all
+            // windows with "extensionLifetime": "application" in their metadata
+            applicationScoped = metaData.value("MetaData").toObject()
+                    .value("extensionLifetime").toString() == "application";
+            cache.store(mPath, implementsInterface, applicationScoped);
+        }
+
+        mApplicationScoped = applicationScoped;
+
+        if (Q_UNLIKELY(!implementsInterface))
+            qWarning() << mPath.filePath() << "doesn't implement application plugin interface";
+        else if (Q_UNLIKELY(!mLoader.load()))
+            qWarning() << "Failed to load application plugin: " << mLoader.errorString();
+        else
+            libraryLoaded = true;
     }
 
-    mInstance = qobject_cast<ApplicationPlugin*>(mLoader.instance());
+    QMutexLocker locker(&mLoadMutex);
+    mLibraryLoaded = libraryLoaded;
+    mLoadTime = timer.elapsed();
+    mLoadState = LoadFinished;
+    mLoadCondition.wakeAll();
+
+    // emitted with the lock held so the destructor can't run in between
+    emit loaded();
+}
+
+bool WebApplicationPlugin::loadFinished()
+{
+    QMutexLocker locker(&mLoadMutex);
+    return mLoadState == LoadFinished;
+}
+
+bool WebApplicationPlugin::waitForLoaded()
+{
+    mLoadMutex.lock();
+
+    if (mLoadState == LoadNotStarted) {
+        mLoadState = LoadRunning;
+        mLoadMutex.unlock();
+        loadLibrary();
+        mLoadMutex.lock();
+    }
+
+    while (mLoadState == LoadRunning)
+        mLoadCondition.wait(&mLoadMutex);
+
+    bool loaded = mLibraryLoaded;
+    mLoadMutex.unlock();
+
+    return loaded;
+}
+
+bool WebApplicationPlugin::checkInterface()
+{
+    if (mInstanceCreated)
+        return mInstance != 0;
+
+    mInstanceCreated = true;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // The root component has to be created on the thread it will live in
+    QObject *root = mLoader.instance();
+    mLifecycle = qobject_cast<LifecycleApplicationPlugin*>(root);
+
+    // Q_INTERFACES of a lifecycle plugin doesn't need to list the base
+    // interface as well
+    mInstance = mLifecycle ? mLifecycle : qobject_cast<ApplicationPlugin*>(root);
     if (Q_UNLIKELY(mInstance == 0)) {
         qWarning() << mPath.filePath() << "doesn't implement application plugin interface";
         return false;
     }
 
+    qDebug() << "Plugin" << mPath.fileName() << "loaded in" << mLoadTime << "ms, instance created in"
+             << timer.elapsed() << "ms";
+
     return true;
 }
 
+/**
+ * Whether the extensions of the plugin are created once per application
+ * and shared by all windows.
+ */
+bool WebApplicationPlugin::applicationScopedExtensions()
+{
+    return load() && mApplicationScoped;
+}
+
 QList<BaseExtension*> WebApplicationPlugin::createExtensions(ApplicationEnvironment *environment)
 {
+    if (!load())
+        return QList<BaseExtension*>();
+
     return mInstance->createExtensions(environment);
 }
 
+/**
+ * Whether the plugin was built against a plugin API with lifecycle hooks.
+ * Only then the hooks may be called on the plugin and its extensions.
+ */
+bool WebApplicationPlugin::hasLifecycleHooks() const
+{
+    return mLifecycle != 0;
+}
+
+// The lifecycle hooks don't force the plugin to be loaded; a plugin which
+// isn't in use yet has nothing to react on
+
+void WebApplicationPlugin::focusChanged(bool focused)
+{
+    if (mLifecycle)
+        mLifecycle->focusChanged(focused);
+}
+
+void WebApplicationPlugin::suspended()
+{
+    if (mLifecycle)
+        mLifecycle->suspended();
+}
+
+void WebApplicationPlugin::resumed()
+{
+    if (mLifecycle)
+        mLifecycle->resumed();
+}
+
+void WebApplicationPlugin::memoryPressure(BaseExtension::MemoryPressureLevel level)
+{
+    if (mLifecycle)
+        mLifecycle->memoryPressure(level);
+}
+
 } // namespace luna
@@ -22,28 +22,73 @@
 #include <QObject>
 #include <QFileInfo>
 #include <QPluginLoader>
-#include <QFileInfo>
+#include <QMutex>
+#include <QWaitCondition>
 
 #include <applicationplugin.h>
 
 namespace luna
 {
 
+/**
+ * Loads the native plugin of an application. Mapping and relocating the
+ * library happens on a worker thread while the application sets up its
+ * windows; the plugin instance itself is created on the GUI thread the
+ * first time extensions are requested.
+ */
 class WebApplicationPlugin : public QObject,
                              public ApplicationPlugin
 {
     Q_OBJECT
 public:
     WebApplicationPlugin(const QFileInfo &path, QObject *parent = 0);
+    ~WebApplicationPlugin();
 
     bool load();
+    void loadAsync();
+    bool loadFinished();
+
+    bool applicationScopedExtensions();
+    bool hasLifecycleHooks() const;
 
     QList<BaseExtension*> createExtensions(ApplicationEnvironment *environment);
 
+    void focusChanged(bool focused);
+    void suspended();
+    void resumed();
+    void memoryPressure(BaseExtension::MemoryPressureLevel level);
+
+Q_SIGNALS:
+    /**
+     * Emitted from the thread which loaded the library once loading
+     * finished, successful or not.
+     */
+    void loaded();
+
 private:
+    friend class PluginLoadTask;
+
+    enum LoadState {
+        LoadNotStarted,
+        LoadRunning,
+        LoadFinished
+    };
+
+    void loadLibrary();
+    bool waitForLoaded();
+    bool checkInterface();
+
     QPluginLoader mLoader;
     ApplicationPlugin *mInstance;
+    LifecycleApplicationPlugin *mLifecycle;
     QFileInfo mPath;
+    QMutex mLoadMutex;
+    QWaitCondition mLoadCondition;
+    LoadState mLoadState;
+    bool mLibraryLoaded;
+    bool mInstanceCreated;
+    bool mApplicationScoped;
+    qint64 mLoadTime;
 };
 
 } // namespace luna
@@ -22,20 +22,41 @@
 #ifndef WITH_UNMODIFIED_QTWEBKIT
 #include <QtWebKit/private/qwebnewpagerequest_p.h>
 #endif
+#ifdef HAVE_WEBKIT2_UIPROCESS_HEADERS
+#include <QtWebKit/private/qquickwebview_p_p.h>
+#include <WebPageProxy.h>
+#include <WebProcessProxy.h>
+#endif
 #include <QtGui/QGuiApplication>
 #include <QtGui/qpa/qplatformnativeinterface.h>
-#include <QJsonDocument>
-#include <QJsonObject>
 #include <QTimer>
+#include <QSettings>
+#include <QThread>
 
 #include <QScreen>
 
+#if QT_VERSION >= QT_VERSION_CHECK(5, 4, 0)
+#include <private/qqmlengine_p.h>
+#include <private/qv4engine_p.h>
+#include <private/qv4mm_p.h>
+#endif
+
 #include <Settings.h>
 
 #include "applicationdescription.h"
 #include "webapplication.h"
 #include "webapplicationwindow.h"
 #include "webapplicationplugin.h"
+#include "bridgestatistics.h"
+#include "eventtrace.h"
+#include "memoryaccounting.h"
+#include "syncmessage.h"
+#include "snapshotcache.h"
+#include "useragentoverrides.h"
+#include "networkstate.h"
+#include "extensiondispatcher.h"
+#include "sharedextensionenvironment.h"
+#include "utils.h"
 
 #include "extensions/palmsystemextension.h"
 #include "extensions/palmservicebridgeextension.h"
@@ -58,18 +79,55 @@ WebApplicationWindow::WebApplicationWindow(WebApplication *application, const QU
     mStagePreparing(true),
     mStageReady(false),
     mShowWindowTimer(this),
-    mSize(size)
+    mStageReadyTimedOut(false),
+    mSize(size),
+    mSuspended(false),
+    mPluginExtensionsCreated(false),
+    mExtensionsInitialized(false),
+    mExtensionsReady(false),
+    mLastLoadFailed(false),
+    mLoadingOfflineCopy(false),
+    mServingOfflineCopy(false)
 {
     connect(&mShowWindowTimer, SIGNAL(timeout()), this, SLOT(onShowWindowTimeout()));
     mShowWindowTimer.setSingleShot(true);
 
     assignCorrectTrustScope();
 
+    // Only the main window gets a snapshot splash; it's the first window
+    // created for an application
+    if (!mHeadless && !mApplication->hasMainWindow())
+        mSnapshot = SnapshotCache::snapshotUrl(mApplication->id());
+
     createAndSetup();
 }
 
 WebApplicationWindow::~WebApplicationWindow()
 {
+    runLifecycleHook([](BaseExtension *extension) {
+        extension->teardown();
+    });
+
+    if (!mExtensionFactories.isEmpty())
+        qDebug() << "Window of" << mApplication->id() << "avoided constructing"
+                 << mExtensionFactories.count() << "unused extensions:" << mExtensionFactories.keys();
+
+    if (!mSharedExtensions.isEmpty())
+        mApplication->sharedExtensionEnvironment()->removeWindow(this);
+
+    QMap<QString, ExtensionDispatcher*>::const_iterator iter;
+    for (iter = mDispatchers.constBegin(); iter != mDispatchers.constEnd(); ++iter)
+        qDebug() << "Extension" << iter.key() << "statistics:" << iter.value()->statistics();
+
+    // Deleting a dispatcher waits for its queue so the teardown hooks queued
+    // above run before the extensions and the root item go away
+    qDeleteAll(mDispatchers);
+    mDispatchers.clear();
+
+    // We gave up waiting for stageReady() and it never came
+    if (mStageReadyTimer.isValid() && mStageReadyTimedOut)
+        mApplication->stageReadyHistory()->addNeverSignaledSample();
+
     delete mRootItem;
 }
 
@@ -97,13 +155,18 @@ void WebApplicationWindow::createAndSetup()
     mEngine.rootContext()->setContextProperty("webApp", mApplication);
     mEngine.rootContext()->setContextProperty("webAppWindow", this);
     mEngine.rootContext()->setContextProperty("webAppUrl", mUrl);
+    mEngine.rootContext()->setContextProperty("userAgentOverrides", UserAgentOverrides::instance());
+    mEngine.rootContext()->setContextProperty("networkState", NetworkState::instance());
 
     connect(&mEngine, &QQmlEngine::quit, [=]() {
         mWindow->close();
     });
 
-    QQmlComponent windowComponent(&mEngine,
-        QUrl(QString("qrc:///qml/%1.qml").arg(mHeadless ? "ApplicationContainer" : "Window")));
+    QString componentName = "Window";
+    if (mHeadless)
+        componentName = mApplication->lightweightHeadless() ? "HeadlessContainer" : "ApplicationContainer";
+
+    QQmlComponent windowComponent(&mEngine, QUrl(QString("qrc:///qml/%1.qml").arg(componentName)));
     if (windowComponent.isError()) {
         qCritical() << "Errors while loading window component:";
         qCritical() << windowComponent.errors();
@@ -158,6 +221,8 @@ void WebApplicationWindow::createAndSetup()
     if (mTrustScope == TrustScopeSystem)
         initializeAllExtensions();
 
+    setupPluginExtensions();
+
     /* If we're running a remote site mark the window as fully loaded */
     if (mTrustScope == TrustScopeRemote)
         stageReady();
@@ -168,7 +233,8 @@ void WebApplicationWindow::onShowWindowTimeout()
     qDebug() << __PRETTY_FUNCTION__;
 
     // we got no stage ready call yet so go forward showing the window
-    stageReady();
+    mStageReadyTimedOut = true;
+    setStageReady();
 }
 
 void WebApplicationWindow::setupPage()
@@ -194,40 +260,100 @@ void WebApplicationWindow::setupPage()
 void WebApplicationWindow::notifyAppAboutFocusState(bool focus)
 {
     qDebug() << "DEBUG: We become" << (focus ? "focused" : "unfocused");
+    EventTrace::record(TraceFocusChange, focus ? 1 : 0);
 
     QString action = focus ? "stageActivated" : "stageDeactivated";
 
     if (mTrustScope == TrustScopeSystem)
         executeScript(QString("if (window.Mojo && Mojo.%1) Mojo.%1()").arg(action));
 
+    runLifecycleHook([focus](BaseExtension *extension) {
+        extension->focusChanged(focus);
+    });
+
     mApplication->changeActivityFocus(focus);
 }
 
 void WebApplicationWindow::onLoadingChanged(QWebLoadRequest *request)
 {
+    EventTrace::record(TraceLoadState, request->status(), 0, request->url().host());
+
     switch (request->status()) {
     case QQuickWebView::LoadStartedStatus:
         setupPage();
         return;
     case QQuickWebView::LoadStoppedStatus:
+        return;
     case QQuickWebView::LoadFailedStatus:
+        mLastLoadFailed = true;
+        if (!mLoadingOfflineCopy && request->url() == mUrl &&
+            request->errorDomain() == QQuickWebView::NetworkErrorDomain)
+            loadOfflineCopy();
+        else
+            mLoadingOfflineCopy = false;
         return;
     case QQuickWebView::LoadSucceededStatus:
         break;
     }
 
+    if (mLoadingOfflineCopy) {
+        // The offline copy stands in for a failed load so we still want to
+        // reload once the network is back
+        mLoadingOfflineCopy = false;
+        setServingOfflineCopy(true);
+    }
+    else {
+        mLastLoadFailed = false;
+        setServingOfflineCopy(false);
+
+        if (request->url() == mUrl && mApplication->offlineCache())
+            mApplication->offlineCache()->revalidate();
+    }
+
+    mLastCommittedUrl = request->url();
+
+    if (mCrashRecoveryTimer.isValid())
+        recordCrashRecovery();
+
     Q_FOREACH(BaseExtension *extension, mExtensions.values())
-        extension->initialize();
+        initializeExtension(extension);
+
+    mExtensionsInitialized = true;
 
     // If we're a headless app we don't show the window and in case of an
     // application with an remote entry point it's already visible at
     // this point
-    if (mHeadless || mApplication->hasRemoteEntryPoint())
+    if (mHeadless) {
+        // Most of what a headless app costs is in its web process
+        qDebug() << "Headless application" << mApplication->id() << "loaded, resident set size launcher"
+                 << MemoryAccounting::processMemory(QCoreApplication::applicationPid()).rss << "kB, web process"
+                 << MemoryAccounting::processMemory(webProcessPid()).rss << "kB";
+        return;
+    }
+
+    if (mApplication->hasRemoteEntryPoint())
+        return;
+
+    if (!mStagePreparing || mStageReady || mShowWindowTimer.isActive())
         return;
 
-    // If we don't got stageReady() start a timeout to wait for it
-    else if (mStagePreparing && !mStageReady && !mShowWindowTimer.isActive())
-        mShowWindowTimer.start(3000);
+    // If we don't got stageReady() start a timeout to wait for it. How long we
+    // wait depends on how long the main window of the app took the last times.
+    int timeout = 3000;
+
+    if (mApplication->isMainWindow(this)) {
+        StageReadyHistory *history = mApplication->stageReadyHistory();
+
+        // We keep timing apps which stopped calling stageReady() so their
+        // history recovers once they call it again
+        if (history->neverSignals())
+            qDebug() << "Application" << mApplication->id() << "never calls stageReady, waiting only shortly";
+
+        timeout = history->timeout();
+        mStageReadyTimer.start();
+    }
+
+    mShowWindowTimer.start(timeout);
 }
 
 #ifndef WITH_UNMODIFIED_QTWEBKIT
@@ -250,50 +376,198 @@ void WebApplicationWindow::onSyncMessageReceived(const QVariantMap& message, QSt
 
     QString data = message.value("data").toString();
 
-    QJsonDocument document = QJsonDocument::fromJson(data.toUtf8());
-
-    if (!document.isObject())
+    SyncMessage syncMessage;
+    if (!SyncMessage::decode(data, syncMessage))
         return;
 
-    QJsonObject rootObject = document.object();
-
-    QString messageType;
-    if (!rootObject.contains("messageType") || !rootObject.value("messageType").isString())
+    BaseExtension *extension = this->extension(syncMessage.extension);
+    if (!extension)
         return;
 
-    messageType = rootObject.value("messageType").toString();
-    if (messageType != "callSyncExtensionFunction")
-        return;
+    const QString &funcName = syncMessage.func;
+    const QJsonArray &params = syncMessage.params;
 
-    if (!(rootObject.contains("extension") && rootObject.value("extension").isString()) ||
-        !(rootObject.contains("func") && rootObject.value("func").isString()) ||
-        !(rootObject.contains("params") && rootObject.value("params").isArray()))
-        return;
+    QElapsedTimer timer;
+    timer.start();
 
-    QString extensionName = rootObject.value("extension").toString();
-    QString funcName = rootObject.value("func").toString();
-    QJsonArray params = rootObject.value("params").toArray();
+    if (mSharedExtensions.contains(extension->name()))
+        response = mApplication->sharedExtensionEnvironment()->callSynchronous(this, extension, funcName, params);
+    else if (mDispatchers.contains(extension->name()))
+        response = mDispatchers.value(extension->name())->callSynchronous(funcName, params);
+    else
+        response = extension->handleSynchronousCall(funcName, params);
 
-    if (!mExtensions.contains(extensionName))
-        return;
+    qint64 duration = timer.nsecsElapsed() / 1000;
 
-    BaseExtension *extension = mExtensions.value(extensionName);
-    response = extension->handleSynchronousCall(funcName, params);
+    EventTrace::record(TraceBridgeSyncCall, duration, response.size(), funcName);
+    BridgeStatistics::instance()->recordCall(mApplication->id(), extension->name(), funcName,
+                                             BridgeStatistics::SynchronousCall,
+                                             duration, data.size(), response.size());
 }
 
 #endif
 
 void WebApplicationWindow::createDefaultExtensions()
 {
-    addExtension(new PalmSystemExtension(this));
+    registerExtension("PalmSystem", QUrl("qrc:///extensions/PalmSystem.js"), [=]() -> BaseExtension* {
+        return new PalmSystemExtension(this);
+    });
     // addExtension(new PalmServiceBridgeExtension(this));
+}
+
+/**
+ * Registers an extension which is only constructed once the page calls it
+ * for the first time. Its user script is injected right away so the page
+ * sees the same API as before.
+ */
+void WebApplicationWindow::registerExtension(const QString &name, const QUrl &userScript,
+                                             std::function<BaseExtension*()> create)
+{
+    if (!userScript.isEmpty())
+        registerUserScript(userScript);
+
+    mExtensionFactories.insert(name, create);
+}
+
+BaseExtension* WebApplicationWindow::extension(const QString &name)
+{
+    if (mExtensions.contains(name))
+        return mExtensions.value(name);
+
+    if (!mExtensionFactories.contains(name))
+        return 0;
+
+    qDebug() << "Creating extension" << name << "on first use";
+
+    BaseExtension *extension = mExtensionFactories.take(name)();
+    addExtension(extension);
+    // Built-in extensions are always built against the current plugin API
+    mLifecycleExtensions.insert(name);
+    emit extensionWantsToBeAdded(name, extension);
+
+    if (mExtensionsInitialized)
+        initializeExtension(extension);
+
+    return extension;
+}
+
+void WebApplicationWindow::initializeExtension(BaseExtension *extension)
+{
+    if (mSharedExtensions.contains(extension->name()))
+        mApplication->sharedExtensionEnvironment()->initialize(this, extension);
+    else if (mDispatchers.contains(extension->name()))
+        mDispatchers.value(extension->name())->initialize();
+    else
+        extension->initialize();
+}
 
-    if (!mApplication->plugin())
+void WebApplicationWindow::loadExtension(const QString &name)
+{
+    extension(name);
+}
+
+/**
+ * Runs an asynchronous call from the page. Extensions which don't live on
+ * the GUI thread get it handed over to their thread. Returns false if there
+ * is no such extension.
+ */
+bool WebApplicationWindow::dispatchExtensionCall(const QString &name, const QString &funcName,
+                                                 const QVariantList &params, bool hasCallbacks, int bytesIn)
+{
+    EventTrace::record(TraceBridgeAsyncCall, bytesIn, 0, funcName);
+
+    if (mSharedExtensions.contains(name)) {
+        mApplication->sharedExtensionEnvironment()->call(this, mExtensions.value(name), funcName,
+                                                         params, hasCallbacks, bytesIn);
+        return true;
+    }
+
+    if (mDispatchers.contains(name)) {
+        mDispatchers.value(name)->call(funcName, params, mApplication->id(), bytesIn);
+        return true;
+    }
+
+    BaseExtension *extension = mExtensions.value(name);
+    if (!extension)
+        return false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    ExtensionDispatcher::invokeMethod(extension, funcName, params);
+
+    BridgeStatistics::instance()->recordCall(mApplication->id(), name, funcName,
+                                             BridgeStatistics::AsynchronousCall,
+                                             timer.nsecsElapsed() / 1000, bytesIn, 0);
+    return true;
+}
+
+/**
+ * Holds the page back until the application plugin finished loading in the
+ * background. Plugin extensions register their user scripts when they are
+ * constructed and those have to be known before the page starts loading.
+ */
+void WebApplicationWindow::setupPluginExtensions()
+{
+    WebApplicationPlugin *plugin = mApplication->plugin();
+    if (mTrustScope == TrustScopeSystem && plugin) {
+        // queued as the plugin may emit with its load lock held
+        connect(plugin, SIGNAL(loaded()), this, SLOT(onPluginLoaded()), Qt::QueuedConnection);
+        if (!plugin->loadFinished())
+            return;
+    }
+
+    onPluginLoaded();
+}
+
+void WebApplicationWindow::onPluginLoaded()
+{
+    if (mExtensionsReady)
+        return;
+
+    createPluginExtensions();
+
+    mExtensionsReady = true;
+    emit extensionsReadyChanged();
+}
+
+/**
+ * Creates the extensions of the application plugin. The plugin library has
+ * to be loaded already, only its instance is created here.
+ */
+void WebApplicationWindow::createPluginExtensions()
+{
+    // Only system applications get extensions at all
+    if (mTrustScope != TrustScopeSystem || mPluginExtensionsCreated || !mApplication->plugin())
         return;
 
+    mPluginExtensionsCreated = true;
+
+    // One set of extensions serves all windows of the application if the
+    // plugin asks for it
+    if (mApplication->plugin()->applicationScopedExtensions()) {
+        SharedExtensionEnvironment *sharedEnvironment = mApplication->sharedExtensionEnvironment();
+        QList<BaseExtension*> extensions = sharedEnvironment->extensions();
+
+        Q_FOREACH(const QUrl &userScript, sharedEnvironment->userScripts())
+            registerUserScript(userScript);
+
+        Q_FOREACH(BaseExtension *extension, extensions) {
+            mSharedExtensions.insert(extension->name());
+            mExtensions.insert(extension->name(), extension);
+            emit extensionWantsToBeAdded(extension->name(), extension);
+        }
+
+        return;
+    }
+
     QList<BaseExtension*> extensions = mApplication->plugin()->createExtensions(this);
+    bool lifecycleHooks = mApplication->plugin()->hasLifecycleHooks();
     Q_FOREACH(BaseExtension *extension, extensions) {
         addExtension(extension);
+        if (lifecycleHooks)
+            mLifecycleExtensions.insert(extension->name());
+        emit extensionWantsToBeAdded(extension->name(), extension);
     }
 }
 
@@ -301,6 +575,17 @@ void WebApplicationWindow::addExtension(BaseExtension *extension)
 {
     qDebug() << "Adding extension" << extension->name();
     mExtensions.insert(extension->name(), extension);
+
+    if (extension->threadAffinity() == BaseExtension::GuiThreadAffinity)
+        return;
+
+    // Qt can't move objects with a parent to another thread
+    if (extension->parent()) {
+        qWarning() << "Extension" << extension->name() << "has a parent, running it on the GUI thread";
+        return;
+    }
+
+    mDispatchers.insert(extension->name(), new ExtensionDispatcher(extension, this));
 }
 
 void WebApplicationWindow::initializeAllExtensions()
@@ -321,6 +606,7 @@ bool WebApplicationWindow::eventFilter(QObject *object, QEvent *event)
     if (object == mWindow) {
         switch (event->type()) {
         case QEvent::Close:
+            captureSnapshot();
             QTimer::singleShot(0, this, SLOT(onClosed()));
             break;
         case QEvent::FocusIn:
@@ -337,6 +623,21 @@ bool WebApplicationWindow::eventFilter(QObject *object, QEvent *event)
     return false;
 }
 
+void WebApplicationWindow::captureSnapshot()
+{
+    // Only take a snapshot of what the app itself rendered and not of our
+    // loading screen
+    if (!mWindow || !mStageReady || mSuspended || !mWindow->isExposed())
+        return;
+
+    if (!mApplication->isMainWindow(this))
+        return;
+
+    // Reading back the frame has to happen here, scaling and encoding is
+    // done by the snapshot cache on a worker thread
+    SnapshotCache::store(mApplication->id(), mWindow->grabWindow());
+}
+
 QString WebApplicationWindow::getIdentifierForFrame(const QString& id, const QString& url)
 {
     QString identifier = mApplication->identifier();
@@ -356,6 +657,16 @@ void WebApplicationWindow::stagePreparing()
 }
 
 void WebApplicationWindow::stageReady()
+{
+    if (mStageReadyTimer.isValid()) {
+        mApplication->stageReadyHistory()->addSample(mStageReadyTimer.elapsed());
+        mStageReadyTimer.invalidate();
+    }
+
+    setStageReady();
+}
+
+void WebApplicationWindow::setStageReady()
 {
     mStagePreparing = false;
     mStageReady = true;
@@ -402,7 +713,205 @@ void WebApplicationWindow::unfocus()
     mWindow->lower();
 }
 
+void WebApplicationWindow::suspend()
+{
+    // Headless windows are running the background part of the application
+    // which has to continue doing its work
+    if (mSuspended || mHeadless || !mWebView)
+        return;
+
+    qDebug() << __PRETTY_FUNCTION__ << "Throttling window of app" << mApplication->id();
+
+    // The card got minimized; grabbing the frame blocks the GUI thread so
+    // it's only done here and on close rather than whenever focus moves
+    captureSnapshot();
+
+    mSuspended = true;
+
+    // The container shows the last frame in place of the web view now. Once
+    // that frame is rendered the web view is hidden: WebKit then treats the
+    // page as hidden, DOM timers are throttled, requestAnimationFrame is
+    // paused and with our own animations stopped nothing renders anymore.
+    // Mojo.stageDeactivated was already sent when the window lost focus.
+    emit suspendedChanged();
+
+    if (mWindow) {
+        mSuspendedFrameConnection = connect(mWindow, &QQuickWindow::frameSwapped,
+                                            this, &WebApplicationWindow::onSuspendedFrameRendered,
+                                            Qt::QueuedConnection);
+        mWindow->update();
+    }
+
+    runLifecycleHook([](BaseExtension *extension) {
+        extension->suspended();
+    });
+}
+
+void WebApplicationWindow::onSuspendedFrameRendered()
+{
+    disconnect(mSuspendedFrameConnection);
+
+    if (mSuspended)
+        mWebView->setVisible(false);
+}
+
+void WebApplicationWindow::resume()
+{
+    if (!mSuspended)
+        return;
+
+    qDebug() << __PRETTY_FUNCTION__ << "Resuming window of app" << mApplication->id();
+
+    mSuspended = false;
+
+    disconnect(mSuspendedFrameConnection);
+    mWebView->setVisible(true);
+
+    emit suspendedChanged();
+
+    if (mWindow)
+        mWindow->update();
+
+    runLifecycleHook([](BaseExtension *extension) {
+        extension->resumed();
+    });
+}
+
+void WebApplicationWindow::close()
+{
+    if (!mWindow)
+        return;
+
+    mWindow->close();
+}
+
+void WebApplicationWindow::releaseCaches()
+{
+    mEngine.trimComponentCache();
+    mEngine.collectGarbage();
+}
+
+void WebApplicationWindow::releaseSceneGraphResources()
+{
+    if (!mWindow || (mWindow->isExposed() && !mSuspended))
+        return;
+
+    mWindow->releaseResources();
+}
+
+void WebApplicationWindow::purgeWebContent()
+{
+    // The web process isn't under our control so let the page know it
+    // should drop whatever it can
+    if (mTrustScope == TrustScopeSystem)
+        executeScript(QString("if (window.Mojo && Mojo.lowMemoryNotification) "
+                              "Mojo.lowMemoryNotification({state: \"critical\"})"));
+}
+
+void WebApplicationWindow::notifyMemoryPressure(BaseExtension::MemoryPressureLevel level)
+{
+    runLifecycleHook([level](BaseExtension *extension) {
+        extension->memoryPressure(level);
+    });
+}
+
+/**
+ * Reports the memory used for this window in kB. Qt has no numbers for the
+ * scene graph so it's left out rather than guessed. The JavaScript heap of
+ * the web page isn't exposed by WebKit, it's part of the web process numbers.
+ */
+QJsonObject WebApplicationWindow::memoryUsage()
+{
+    QJsonObject usage;
+    usage.insert("url", mUrl.toString());
+    usage.insert("suspended", mSuspended);
+    usage.insert("headless", mHeadless);
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 4, 0)
+    QV4::ExecutionEngine *v4 = QQmlEnginePrivate::getV4Engine(&mEngine);
+    if (v4) {
+        usage.insert("qmlHeapUsed", (double) (v4->memoryManager->getUsedMem() / 1024));
+        usage.insert("qmlHeapAllocated", (double) ((v4->memoryManager->getAllocatedMem() +
+                                                    v4->memoryManager->getLargeItemsMem()) / 1024));
+    }
+#endif
+
+    if (mRootItem)
+        usage.insert("qmlObjects", mRootItem->findChildren<QObject*>().count() + 1);
+
+    qint64 pid = webProcessPid();
+    if (pid > 0) {
+        MemoryAccounting::ProcessMemory memory = MemoryAccounting::processMemory(pid);
+
+        QJsonObject webProcess;
+        webProcess.insert("pid", (double) pid);
+        webProcess.insert("rss", (double) memory.rss);
+        webProcess.insert("pss", (double) memory.pss);
+        webProcess.insert("swap", (double) memory.swap);
+        usage.insert("webProcess", webProcess);
+    }
+
+    return usage;
+}
+
+/**
+ * The web process currently rendering our page as the page proxy knows it;
+ * it changes when the process gets restarted after a crash. 0 when no
+ * process is running (yet) or we're built without WebKit's UI process
+ * headers.
+ */
+qint64 WebApplicationWindow::webProcessPid() const
+{
+#ifdef HAVE_WEBKIT2_UIPROCESS_HEADERS
+    if (!mWebView)
+        return 0;
+
+    QQuickWebViewPrivate *webViewPrivate = QQuickWebViewPrivate::get(mWebView);
+    if (!webViewPrivate->webPageProxy)
+        return 0;
+
+    WebKit::WebProcessProxy *process = webViewPrivate->webPageProxy->process();
+    if (!process || process->isLaunching() || !process->processIdentifier())
+        return 0;
+
+    return process->processIdentifier()->pid();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Runs a lifecycle hook on the extensions of this window which know about
+ * lifecycle hooks. Extensions shared between the windows get them from the
+ * application instead.
+ */
+void WebApplicationWindow::runLifecycleHook(const std::function<void(BaseExtension*)> &hook)
+{
+    Q_FOREACH(const QString &name, mLifecycleExtensions) {
+        if (mDispatchers.contains(name))
+            mDispatchers.value(name)->runHook(hook);
+        else
+            hook(mExtensions.value(name));
+    }
+}
+
 void WebApplicationWindow::executeScript(const QString &script)
+{
+    // Extensions running on their own thread call back from there; the QML
+    // side may only be touched from the GUI thread
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, "onScriptFromExtensionThread", Qt::QueuedConnection,
+                                  Q_ARG(QString, script));
+        return;
+    }
+
+    EventTrace::record(TraceScriptInjection, script.size(), 0, script);
+    BridgeStatistics::instance()->recordScript(mApplication->id(), script.size());
+
+    emit javaScriptExecNeeded(script);
+}
+
+void WebApplicationWindow::onScriptFromExtensionThread(const QString &script)
 {
     emit javaScriptExecNeeded(script);
 }
@@ -443,6 +952,15 @@ QList<QUrl> WebApplicationWindow::userScripts() const
     return mUserScripts;
 }
 
+/**
+ * Whether all extensions which bring their own user scripts are set up and
+ * the page can be loaded.
+ */
+bool WebApplicationWindow::extensionsReady() const
+{
+    return mExtensionsReady;
+}
+
 bool WebApplicationWindow::ready() const
 {
     return mStageReady && !mStagePreparing;
@@ -458,6 +976,110 @@ bool WebApplicationWindow::active() const
     return mWindow->isActive();
 }
 
+static QString crashStatisticsPath(const QString &appId)
+{
+    return launcherCachePath(QString("crashes/%1").arg(appId));
+}
+
+void WebApplicationWindow::recordProcessCrash()
+{
+    // Keep the time of the first crash when the restart crashes again
+    if (!mCrashRecoveryTimer.isValid())
+        mCrashRecoveryTimer.start();
+
+    QSettings statistics(crashStatisticsPath(mApplication->id()), QSettings::IniFormat);
+    int crashes = statistics.value("crashes", 0).toInt() + 1;
+    statistics.setValue("crashes", crashes);
+
+    qWarning("Web process of application %s crashed (%d crashes so far)",
+             mApplication->id().toUtf8().constData(), crashes);
+}
+
+void WebApplicationWindow::recordCrashRecovery()
+{
+    qint64 recoveryTime = mCrashRecoveryTimer.elapsed();
+    mCrashRecoveryTimer.invalidate();
+
+    QSettings statistics(crashStatisticsPath(mApplication->id()), QSettings::IniFormat);
+    int recoveries = statistics.value("recoveries", 0).toInt() + 1;
+    statistics.setValue("recoveries", recoveries);
+    statistics.setValue("lastRecoveryTime", recoveryTime);
+    statistics.setValue("totalRecoveryTime", statistics.value("totalRecoveryTime", 0).toLongLong() + recoveryTime);
+
+    qWarning("Application %s recovered from a web process crash in %lld ms",
+             mApplication->id().toUtf8().constData(), recoveryTime);
+}
+
+QUrl WebApplicationWindow::lastCommittedUrl() const
+{
+    return mLastCommittedUrl;
+}
+
+bool WebApplicationWindow::lastLoadFailed() const
+{
+    return mLastLoadFailed;
+}
+
+bool WebApplicationWindow::servingOfflineCopy() const
+{
+    return mServingOfflineCopy;
+}
+
+void WebApplicationWindow::setServingOfflineCopy(bool serving)
+{
+    if (mServingOfflineCopy == serving)
+        return;
+
+    mServingOfflineCopy = serving;
+    emit servingOfflineCopyChanged();
+}
+
+bool WebApplicationWindow::loadOfflineCopy()
+{
+    OfflineCache *cache = mApplication->offlineCache();
+    if (!cache || !cache->isAvailable())
+        return false;
+
+    // The document is built on a worker thread, other windows of the app
+    // may wait for it at the same time
+    connect(cache, SIGNAL(offlineDocumentReady(QString)),
+            this, SLOT(onOfflineDocumentReady(QString)), Qt::UniqueConnection);
+
+    mLoadingOfflineCopy = true;
+    cache->prepareOfflineDocument();
+
+    return true;
+}
+
+void WebApplicationWindow::onOfflineDocumentReady(const QString &document)
+{
+    disconnect(mApplication->offlineCache(), SIGNAL(offlineDocumentReady(QString)),
+               this, SLOT(onOfflineDocumentReady(QString)));
+
+    if (!mLoadingOfflineCopy)
+        return;
+
+    if (document.isEmpty()) {
+        mLoadingOfflineCopy = false;
+        return;
+    }
+
+    qDebug() << "Loading offline copy of" << mUrl;
+
+    // Keep the entry point as base url so the application stays in its origin
+    mWebView->loadHtml(document, mUrl, mUrl);
+}
+
+QUrl WebApplicationWindow::snapshot() const
+{
+    return mSnapshot;
+}
+
+bool WebApplicationWindow::suspended() const
+{
+    return mSuspended;
+}
+
 QString WebApplicationWindow::trustScope() const
 {
     if (mTrustScope == TrustScopeSystem)
@@ -22,6 +22,11 @@
 #include <QQmlEngine>
 #include <QQuickWindow>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QJsonObject>
+
+#include <functional>
 
 #include <QtWebKit/private/qquickwebview_p.h>
 #ifndef WITH_UNMODIFIED_QTWEBKIT
@@ -30,11 +35,12 @@
 #include <QtWebKit/private/qwebloadrequest_p.h>
 
 #include <applicationenvironment.h>
+#include <baseextension.h>
 
 namespace luna
 {
 
-class BaseExtension;
+class ExtensionDispatcher;
 class WebApplication;
 
 enum TrustScope
@@ -48,10 +54,16 @@ class WebApplicationWindow : public ApplicationEnvironment
     Q_OBJECT
     Q_PROPERTY(WebApplication *application READ application)
     Q_PROPERTY(QList<QUrl> userScripts READ userScripts)
+    Q_PROPERTY(bool extensionsReady READ extensionsReady NOTIFY extensionsReadyChanged)
     Q_PROPERTY(bool ready READ ready NOTIFY readyChanged)
     Q_PROPERTY(QSize size READ size NOTIFY sizeChanged)
     Q_PROPERTY(bool active READ active NOTIFY activeChanged)
     Q_PROPERTY(QString trustScope READ trustScope CONSTANT)
+    Q_PROPERTY(bool suspended READ suspended NOTIFY suspendedChanged)
+    Q_PROPERTY(QUrl snapshot READ snapshot CONSTANT)
+    Q_PROPERTY(QUrl lastCommittedUrl READ lastCommittedUrl)
+    Q_PROPERTY(bool lastLoadFailed READ lastLoadFailed)
+    Q_PROPERTY(bool servingOfflineCopy READ servingOfflineCopy NOTIFY servingOfflineCopyChanged)
 
 public:
     explicit WebApplicationWindow(WebApplication *application, const QUrl& url, const QString& windowType,
@@ -68,6 +80,17 @@ public:
     void focus();
     void unfocus();
 
+    void suspend();
+    void resume();
+    void close();
+
+    void releaseCaches();
+    void releaseSceneGraphResources();
+    void purgeWebContent();
+    void notifyMemoryPressure(BaseExtension::MemoryPressureLevel level);
+    QJsonObject memoryUsage();
+    qint64 webProcessPid() const;
+
     bool ready() const;
     bool headless() const;
     bool keepAlive() const;
@@ -75,8 +98,19 @@ public:
     QSize size() const;
     bool active() const;
     QString trustScope() const;
+    bool suspended() const;
+    QUrl snapshot() const;
+    QUrl lastCommittedUrl() const;
+    bool lastLoadFailed() const;
+    bool servingOfflineCopy() const;
+
+    Q_INVOKABLE void recordProcessCrash();
+    Q_INVOKABLE void loadExtension(const QString &name);
+    Q_INVOKABLE bool dispatchExtensionCall(const QString &name, const QString &funcName,
+                                           const QVariantList &params, bool hasCallbacks, int bytesIn);
 
     QList<QUrl> userScripts() const;
+    bool extensionsReady() const;
 
     void setKeepAlive(bool alive);
 
@@ -92,6 +126,9 @@ Q_SIGNALS:
     void readyChanged();
     void sizeChanged();
     void activeChanged();
+    void suspendedChanged();
+    void servingOfflineCopyChanged();
+    void extensionsReadyChanged();
 
 protected:
     bool eventFilter(QObject *object, QEvent *event);
@@ -105,10 +142,18 @@ private Q_SLOTS:
     void onClosed();
     void onLoadingChanged(QWebLoadRequest *request);
     void onShowWindowTimeout();
+    void onScriptFromExtensionThread(const QString &script);
+    void onPluginLoaded();
+    void onSuspendedFrameRendered();
+    void onOfflineDocumentReady(const QString &document);
 
 private:
     WebApplication *mApplication;
     QMap<QString, BaseExtension*> mExtensions;
+    QMap<QString, std::function<BaseExtension*()> > mExtensionFactories;
+    QMap<QString, ExtensionDispatcher*> mDispatchers;
+    QSet<QString> mSharedExtensions;
+    QSet<QString> mLifecycleExtensions;
     QQmlEngine mEngine;
     QObject *mRootItem;
     QQuickWindow *mWindow;
@@ -120,18 +165,43 @@ private:
     bool mStagePreparing;
     bool mStageReady;
     QTimer mShowWindowTimer;
+    QElapsedTimer mStageReadyTimer;
+    bool mStageReadyTimedOut;
     QList<QUrl> mUserScripts;
     QSize mSize;
     TrustScope mTrustScope;
+    bool mSuspended;
+    QMetaObject::Connection mSuspendedFrameConnection;
+    QUrl mSnapshot;
+    QUrl mLastCommittedUrl;
+    bool mPluginExtensionsCreated;
+    bool mExtensionsInitialized;
+    bool mExtensionsReady;
+    bool mLastLoadFailed;
+    bool mLoadingOfflineCopy;
+    bool mServingOfflineCopy;
+    QElapsedTimer mCrashRecoveryTimer;
 
     void assignCorrectTrustScope();
     void createAndSetup();
     void initializeAllExtensions();
     void addExtension(BaseExtension *extension);
     void createDefaultExtensions();
+    void setupPluginExtensions();
+    void createPluginExtensions();
+    void registerExtension(const QString &name, const QUrl &userScript,
+                           std::function<BaseExtension*()> create);
+    BaseExtension* extension(const QString &name);
+    void initializeExtension(BaseExtension *extension);
+    void runLifecycleHook(const std::function<void(BaseExtension*)> &hook);
     void setWindowProperty(const QString &name, const QVariant &value);
     void setupPage();
     void notifyAppAboutFocusState(bool focus);
+    void setStageReady();
+    void captureSnapshot();
+    void recordCrashRecovery();
+    bool loadOfflineCopy();
+    void setServingOfflineCopy(bool serving);
 };
 
 } // namespace luna